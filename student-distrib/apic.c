@@ -0,0 +1,364 @@
+/* apic.c - Functions to deliver interrupts through the local APIC and IO-APIC
+ * vim:ts=4 noexpandtab
+ */
+
+#include "apic.h"
+#include "lib.h"
+#include "i8259.h"
+#include "paging.h"
+#include "handlers.h"
+#include "pit_drivers.h"
+#include "spinlock.h"
+#include "fpu.h"
+
+uint32_t apic_enabled = 0;
+
+/* Virtual addresses of the register blocks (identity mapped) */
+static volatile uint32_t* lapic = NULL;
+static volatile uint32_t* ioapic = NULL;
+
+/* Number of redirection entries the IO-APIC has */
+static uint32_t ioapic_entries = 0;
+
+/* LAPIC timer count that makes up one scheduler tick */
+static uint32_t lapic_tick_count = 0;
+
+/* Lock protecting the IO-APIC's select and window registers */
+static spinlock_t ioapic_lock = SPINLOCK_UNLOCKED;
+
+#define LAPIC_REG(offset) (lapic[(offset) / sizeof(uint32_t)])
+
+static uint32_t ioapic_read(uint32_t reg);
+static void ioapic_write(uint32_t reg, uint32_t value);
+static void lapic_timer_calibrate(void);
+static void lapic_send_icr(uint32_t high, uint32_t low);
+
+/*
+ * apic_init
+ *   DESCRIPTION: Switches interrupt delivery from the 8259 to the APICs. The
+ *                LAPIC is enabled, every ISA IRQ is given a masked IO-APIC
+ *                entry with the vector the 8259 gave it (so the IDT doesn't
+ *                change), and the 8259 is masked off. If the processor has no
+ *                LAPIC, or the APICs aren't at their usual addresses (there is
+ *                no ACPI table parsing), the 8259 stays in use.
+ *   INPUTS: None
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: Must be called after i8259_init and paging_init, and before
+ *                 any device enables its IRQ
+ */
+void apic_init(void)
+{
+    /* Local variables */
+    uint32_t features; /* Feature flags from CPUID */
+    uint32_t base_lo;  /* IA32_APIC_BASE MSR */
+    uint32_t base_hi;
+    uint32_t i;        /* Iteration variable */
+    uint32_t flags;    /* Save variable for flags */
+
+    asm volatile ("cpuid"
+            : "=d"(features)
+            : "a"(CPUID_FEATURES)
+            : "ebx", "ecx"
+    );
+    if (!(features & CPUID_APIC))
+    {
+        return;
+    }
+
+    asm volatile ("rdmsr" : "=a"(base_lo), "=d"(base_hi) : "c"(IA32_APIC_BASE_MSR));
+    if ((base_lo & APIC_BASE_ADDR_MASK) != LAPIC_DEFAULT_BASE)
+    {
+        return;
+    }
+
+    cli_and_save(flags);
+
+    /* Map the registers; they are uncached by the default memory type ranges */
+    page_modify(IOAPIC_DEFAULT_BASE, IOAPIC_DEFAULT_BASE, 0);
+    lapic = (volatile uint32_t*)LAPIC_DEFAULT_BASE;
+    ioapic = (volatile uint32_t*)IOAPIC_DEFAULT_BASE;
+
+    /* Turn on the LAPIC and accept every priority */
+    base_lo |= APIC_BASE_ENABLE;
+    asm volatile ("wrmsr" : : "a"(base_lo), "d"(base_hi), "c"(IA32_APIC_BASE_MSR));
+    LAPIC_REG(LAPIC_SVR) = LAPIC_SVR_ENABLE | APIC_SPURIOUS_INTERRUPT;
+    LAPIC_REG(LAPIC_TPR) = 0;
+    LAPIC_REG(LAPIC_LVT_TIMER) = LAPIC_LVT_MASKED | PIT_INTERRUPT;
+
+    /* Mask every IO-APIC input, pointing the ISA IRQs at the boot processor */
+    ioapic_entries = ((ioapic_read(IOAPIC_VERSION) >> IOAPIC_MAX_ENTRY_SHIFT) & IOAPIC_MAX_ENTRY_MASK) + 1;
+    for (i = 0; i < ioapic_entries; i++)
+    {
+        ioapic_write(IOAPIC_REDIRECTION + 2 * i, IOAPIC_ENTRY_MASKED | (IRQ_VECTOR_BASE + i));
+        ioapic_write(IOAPIC_REDIRECTION + 2 * i + 1, (LAPIC_REG(LAPIC_ID) >> LAPIC_ID_SHIFT) << IOAPIC_DEST_SHIFT);
+    }
+
+    /* The 8259 only ever sends spurious interrupts from now on */
+    outb(MASK, MASTER_8259_PORT + 1);
+    outb(MASK, SLAVE_8259_PORT + 1);
+
+    lapic_timer_calibrate();
+    apic_enabled = 1;
+
+    restore_flags(flags);
+}
+
+/*
+ * ioapic_read
+ *   DESCRIPTION: Reads an IO-APIC register
+ *   INPUTS: reg: The register to read
+ *   OUTPUTS: None
+ *   RETURN VALUE: The value of the register
+ *   SIDE EFFECTS: ioapic_lock must be held (or interrupts off during init)
+ */
+static uint32_t ioapic_read(uint32_t reg)
+{
+    ioapic[IOAPIC_REGSEL / sizeof(uint32_t)] = reg;
+    return ioapic[IOAPIC_WINDOW / sizeof(uint32_t)];
+}
+
+/*
+ * ioapic_write
+ *   DESCRIPTION: Writes an IO-APIC register
+ *   INPUTS: reg: The register to write
+ *           value: The value to write
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: ioapic_lock must be held (or interrupts off during init)
+ */
+static void ioapic_write(uint32_t reg, uint32_t value)
+{
+    ioapic[IOAPIC_REGSEL / sizeof(uint32_t)] = reg;
+    ioapic[IOAPIC_WINDOW / sizeof(uint32_t)] = value;
+}
+
+/*
+ * ioapic_enable_irq
+ *   DESCRIPTION: Unmasks the IO-APIC entry of an ISA IRQ. ISA IRQs are assumed
+ *                to be wired to the IO-APIC input with the same number, which
+ *                holds for every IRQ the kernel uses besides the PIT's.
+ *   INPUTS: irq_num: The IRQ to enable
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void ioapic_enable_irq(uint32_t irq_num)
+{
+    uint32_t flags;
+
+    if (irq_num >= ioapic_entries)
+    {
+        return;
+    }
+
+    spin_lock_irqsave(&ioapic_lock, flags);
+    ioapic_write(IOAPIC_REDIRECTION + 2 * irq_num, IRQ_VECTOR_BASE + irq_num);
+    spin_unlock_irqrestore(&ioapic_lock, flags);
+}
+
+/*
+ * ioapic_disable_irq
+ *   DESCRIPTION: Masks the IO-APIC entry of an ISA IRQ
+ *   INPUTS: irq_num: The IRQ to disable
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void ioapic_disable_irq(uint32_t irq_num)
+{
+    uint32_t flags;
+
+    if (irq_num >= ioapic_entries)
+    {
+        return;
+    }
+
+    spin_lock_irqsave(&ioapic_lock, flags);
+    ioapic_write(IOAPIC_REDIRECTION + 2 * irq_num, IOAPIC_ENTRY_MASKED | (IRQ_VECTOR_BASE + irq_num));
+    spin_unlock_irqrestore(&ioapic_lock, flags);
+}
+
+/*
+ * lapic_eoi
+ *   DESCRIPTION: Ends the highest priority interrupt in service. The LAPIC
+ *                knows which one that is, so a single store does it.
+ *   INPUTS: None
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void lapic_eoi(void)
+{
+    LAPIC_REG(LAPIC_EOI) = 0;
+}
+
+/*
+ * lapic_timer_calibrate
+ *   DESCRIPTION: Counts how far the LAPIC timer runs during one scheduler tick
+ *                by letting it count down while PIT channel 2 times a tick
+ *   INPUTS: None
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: Interrupts must be disabled. Uses PIT channel 2, so the
+ *                 speaker is turned off.
+ */
+static void lapic_timer_calibrate(void)
+{
+    uint8_t gate;
+
+    /* Gate channel 2 off with the speaker disconnected, and load one tick */
+    gate = inb(PIT_GATE_PORT) & ~(PIT_GATE_ENABLE | PIT_SPEAKER_ENABLE);
+    outb(gate, PIT_GATE_PORT);
+    outb(PIT_CHANNEL_2_ONESHOT, MODE_CMD_REGISTER);
+    outb(_40_HZ & LOWMASK, PIT_CHANNEL_2_DATAPORT);
+    outb((_40_HZ & HIGHMASK) >> ONE_BYTE, PIT_CHANNEL_2_DATAPORT);
+
+    /* Start both counters together and wait for the PIT's to run out */
+    LAPIC_REG(LAPIC_TIMER_DIVIDE) = LAPIC_TIMER_DIVIDE_16;
+    outb(gate | PIT_GATE_ENABLE, PIT_GATE_PORT);
+    LAPIC_REG(LAPIC_TIMER_INITIAL) = 0xFFFFFFFF;
+    while (!(inb(PIT_GATE_PORT) & PIT_CHANNEL_2_OUT));
+    lapic_tick_count = 0xFFFFFFFF - LAPIC_REG(LAPIC_TIMER_CURRENT);
+
+    LAPIC_REG(LAPIC_TIMER_INITIAL) = 0;
+    outb(gate, PIT_GATE_PORT);
+}
+
+/*
+ * lapic_timer_arm
+ *   DESCRIPTION: Arms the LAPIC timer to interrupt once, one scheduler tick from
+ *                now, replacing any interrupt that was already armed. It uses
+ *                the PIT's vector, so PIT_interrupt handles it.
+ *   INPUTS: None
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void lapic_timer_arm(void)
+{
+    LAPIC_REG(LAPIC_LVT_TIMER) = PIT_INTERRUPT;
+    LAPIC_REG(LAPIC_TIMER_INITIAL) = lapic_tick_count;
+}
+
+/*
+ * lapic_id
+ *   DESCRIPTION: Reads the ID of the LAPIC of the processor this runs on, which
+ *                is how the processors tell themselves apart (see cpu.h)
+ *   INPUTS: None
+ *   OUTPUTS: None
+ *   RETURN VALUE: The LAPIC ID
+ *   SIDE EFFECTS: None
+ */
+uint32_t lapic_id(void)
+{
+    return LAPIC_REG(LAPIC_ID) >> LAPIC_ID_SHIFT;
+}
+
+/*
+ * lapic_init_ap
+ *   DESCRIPTION: Enables the LAPIC of an application processor the same way
+ *                apic_init does the bootstrap processor's. Every LAPIC has its
+ *                own timer, which is assumed to run at the rate the bootstrap
+ *                processor's was calibrated at.
+ *   INPUTS: None
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: Interrupts must be disabled
+ */
+void lapic_init_ap(void)
+{
+    LAPIC_REG(LAPIC_SVR) = LAPIC_SVR_ENABLE | APIC_SPURIOUS_INTERRUPT;
+    LAPIC_REG(LAPIC_TPR) = 0;
+    LAPIC_REG(LAPIC_LVT_TIMER) = LAPIC_LVT_MASKED | PIT_INTERRUPT;
+    LAPIC_REG(LAPIC_TIMER_DIVIDE) = LAPIC_TIMER_DIVIDE_16;
+}
+
+/*
+ * lapic_delay
+ *   DESCRIPTION: Busy waits by letting the LAPIC timer count down with its
+ *                interrupt masked
+ *   INPUTS: us: Number of microseconds to wait
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: Cancels any armed tick; only used before the scheduler starts
+ */
+void lapic_delay(uint32_t us)
+{
+    LAPIC_REG(LAPIC_LVT_TIMER) = LAPIC_LVT_MASKED | PIT_INTERRUPT;
+    LAPIC_REG(LAPIC_TIMER_INITIAL) = (lapic_tick_count / LAPIC_TICK_US) * us + 1;
+    while (LAPIC_REG(LAPIC_TIMER_CURRENT));
+}
+
+/*
+ * lapic_send_icr
+ *   DESCRIPTION: Sends an IPI by writing the interrupt command register, once
+ *                the previous IPI has been accepted
+ *   INPUTS: high: Value for the high half, holding the destination
+ *           low: Value for the low half, which sends the IPI
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+static void lapic_send_icr(uint32_t high, uint32_t low)
+{
+    uint32_t flags;
+
+    /* The two halves are written separately, so nothing on this processor may send in between */
+    cli_and_save(flags);
+    while (LAPIC_REG(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING);
+    LAPIC_REG(LAPIC_ICR_HIGH) = high;
+    LAPIC_REG(LAPIC_ICR_LOW) = low;
+    restore_flags(flags);
+}
+
+/*
+ * lapic_send_ipi
+ *   DESCRIPTION: Sends a fixed interrupt to one processor
+ *   INPUTS: apic_id: LAPIC ID of the processor
+ *           vector: The vector to interrupt it with
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void lapic_send_ipi(uint32_t apic_id, uint32_t vector)
+{
+    lapic_send_icr(apic_id << LAPIC_ID_SHIFT, LAPIC_ICR_ASSERT | vector);
+}
+
+/*
+ * lapic_broadcast_ipi
+ *   DESCRIPTION: Sends a fixed interrupt to every processor but this one
+ *   INPUTS: vector: The vector to interrupt them with
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void lapic_broadcast_ipi(uint32_t vector)
+{
+    lapic_send_icr(0, LAPIC_ICR_ALL_BUT_SELF | LAPIC_ICR_ASSERT | vector);
+}
+
+/*
+ * lapic_start_aps
+ *   DESCRIPTION: Starts the application processors with the INIT-SIPI-SIPI
+ *                sequence. They are all reset and then sent to the start
+ *                address in real mode, twice in case the first startup IPI is
+ *                missed (a processor that has already started ignores it).
+ *   INPUTS: start: Physical address the processors start at; the startup IPI
+ *                  only has room for its page number, so it is 4KB aligned
+ *                  and below 1MB
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: Takes about 10ms
+ */
+void lapic_start_aps(uint32_t start)
+{
+    lapic_send_icr(0, LAPIC_ICR_ALL_BUT_SELF | LAPIC_ICR_ASSERT | LAPIC_ICR_INIT);
+    lapic_delay(AP_INIT_DELAY_US);
+
+    lapic_send_icr(0, LAPIC_ICR_ALL_BUT_SELF | LAPIC_ICR_ASSERT | LAPIC_ICR_STARTUP | (start >> LAPIC_STARTUP_SHIFT));
+    lapic_delay(AP_STARTUP_DELAY_US);
+    lapic_send_icr(0, LAPIC_ICR_ALL_BUT_SELF | LAPIC_ICR_ASSERT | LAPIC_ICR_STARTUP | (start >> LAPIC_STARTUP_SHIFT));
+    lapic_delay(AP_STARTUP_DELAY_US);
+}
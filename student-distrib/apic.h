@@ -0,0 +1,120 @@
+/* apic.h - Defines used in interactions with the local APIC and the IO-APIC
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _APIC_H
+#define _APIC_H
+
+#include "types.h"
+
+/* CPUID feature bit (EDX of leaf 1, see fpu.h) for an on-chip local APIC */
+#define CPUID_APIC              0x00000200
+
+/* Model specific register holding the LAPIC's base address */
+#define IA32_APIC_BASE_MSR      0x1B
+#define APIC_BASE_ENABLE        0x00000800
+#define APIC_BASE_ADDR_MASK     0xFFFFF000
+
+/* Default physical addresses of the LAPIC and IO-APIC registers. Both sit in
+ * the same 4MB page, which is identity mapped for the kernel. */
+#define LAPIC_DEFAULT_BASE      0xFEE00000
+#define IOAPIC_DEFAULT_BASE     0xFEC00000
+
+/* LAPIC register offsets */
+#define LAPIC_ID                0x020
+#define LAPIC_TPR               0x080
+#define LAPIC_EOI               0x0B0
+#define LAPIC_SVR               0x0F0
+#define LAPIC_LVT_TIMER         0x320
+#define LAPIC_TIMER_INITIAL     0x380
+#define LAPIC_TIMER_CURRENT     0x390
+#define LAPIC_TIMER_DIVIDE      0x3E0
+#define LAPIC_ICR_LOW           0x300
+#define LAPIC_ICR_HIGH          0x310
+
+#define LAPIC_ID_SHIFT          24
+#define LAPIC_SVR_ENABLE        0x100
+#define LAPIC_LVT_MASKED        0x10000
+#define LAPIC_TIMER_DIVIDE_16   0x03
+
+/* Interrupt command register bits for sending IPIs (the destination goes in the
+ * high half, shifted like the ID) */
+#define LAPIC_ICR_INIT          0x00000500
+#define LAPIC_ICR_STARTUP       0x00000600
+#define LAPIC_ICR_PENDING       0x00001000
+#define LAPIC_ICR_ASSERT        0x00004000
+#define LAPIC_ICR_ALL_BUT_SELF  0x000C0000
+
+/* The startup IPI takes the page number of the start address */
+#define LAPIC_STARTUP_SHIFT     12
+
+/* Length of the scheduler tick the LAPIC timer is calibrated over, in microseconds (25ms, see pit_drivers.h) */
+#define LAPIC_TICK_US           25000
+
+/* Waits in the INIT-SIPI-SIPI sequence that starts the application processors */
+#define AP_INIT_DELAY_US        10000
+#define AP_STARTUP_DELAY_US     200
+
+/* xAPIC IDs are 8 bits */
+#define MAX_APIC_IDS            0x100
+
+/* IO-APIC registers, reached through its select and window registers */
+#define IOAPIC_REGSEL           0x00
+#define IOAPIC_WINDOW           0x10
+#define IOAPIC_VERSION          0x01
+#define IOAPIC_REDIRECTION      0x10
+#define IOAPIC_MAX_ENTRY_SHIFT  16
+#define IOAPIC_MAX_ENTRY_MASK   0xFF
+
+/* Redirection entry bits (fixed delivery, physical destination, edge triggered, active high) */
+#define IOAPIC_ENTRY_MASKED     0x10000
+#define IOAPIC_DEST_SHIFT       24
+
+/* First vector used by device interrupts; ISA IRQs keep the vectors the 8259 gave them */
+#define IRQ_VECTOR_BASE         0x20
+
+/* PIT channel 2 and its gate, used to time the LAPIC timer */
+#define PIT_CHANNEL_2_DATAPORT  0x42
+#define PIT_CHANNEL_2_ONESHOT   0xB0
+#define PIT_GATE_PORT           0x61
+#define PIT_GATE_ENABLE         0x01
+#define PIT_SPEAKER_ENABLE      0x02
+#define PIT_CHANNEL_2_OUT       0x20
+
+/* Flag for whether interrupts are delivered by the APICs instead of the 8259 */
+extern uint32_t apic_enabled;
+
+/* Switch interrupt delivery to the APICs, leaving the 8259 in use if there is no LAPIC */
+extern void apic_init(void);
+
+/* Route an ISA IRQ through the IO-APIC */
+extern void ioapic_enable_irq(uint32_t irq_num);
+
+/* Stop an ISA IRQ from being delivered */
+extern void ioapic_disable_irq(uint32_t irq_num);
+
+/* Signal the end of the interrupt being serviced */
+extern void lapic_eoi(void);
+
+/* Arm a one-shot LAPIC timer interrupt for one scheduler tick from now */
+extern void lapic_timer_arm(void);
+
+/* Get the ID of this processor's LAPIC */
+extern uint32_t lapic_id(void);
+
+/* Enable the LAPIC of an application processor */
+extern void lapic_init_ap(void);
+
+/* Busy wait using the LAPIC timer */
+extern void lapic_delay(uint32_t us);
+
+/* Send an interrupt to the processor with the given LAPIC ID */
+extern void lapic_send_ipi(uint32_t apic_id, uint32_t vector);
+
+/* Send an interrupt to every other processor */
+extern void lapic_broadcast_ipi(uint32_t vector);
+
+/* Start every other processor in real mode at a page-aligned address below 1MB */
+extern void lapic_start_aps(uint32_t start);
+
+#endif /* _APIC_H */
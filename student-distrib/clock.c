@@ -0,0 +1,167 @@
+/* clock.c - Functions for the time page shared with user programs
+ * vim:ts=4 noexpandtab
+ */
+
+#include "clock.h"
+#include "fpu.h"
+#include "lib.h"
+#include "paging.h"
+#include "pit_drivers.h"
+#include "scheduling.h"
+#include "cpu.h"
+
+/* The bootstrap processor's time page; it gets a whole page so nothing else of the kernel is visible to users */
+uint32_t time_page_area[SIZE_TABLE] __attribute__((aligned(ALIGNMENT_SIZE)));
+
+/* The bootstrap processor's time page as the kernel writes it */
+static time_page_t* const time_page = (time_page_t*)time_page_area;
+
+/* Time pages of the application processors */
+static uint32_t ap_time_page_area[NUM_AP_TSS][SIZE_TABLE] __attribute__((aligned(ALIGNMENT_SIZE)));
+
+/* Ticks of the bootstrap processor so far */
+static uint32_t clock_ticks = 0;
+
+/* Read the TSC */
+#define rdtsc(lo, hi) do {                      \
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi)); \
+} while (0)
+
+/*
+ * clock_init
+ *   DESCRIPTION: Fills in the time page. If the processor has a TSC, it is
+ *                timed against PIT channel 2 (the speaker's, so channel 0 is
+ *                left to the scheduler) to find its rate, and the clock starts
+ *                from its current value. Without a TSC, user programs can only
+ *                count ticks, so the bootstrap processor keeps ticking for
+ *                them (see clock_needs_tick).
+ *   INPUTS: None
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: Busy waits for 10ms; must be called before the speaker is used
+ */
+void clock_init(void)
+{
+    /* Local variables */
+    uint32_t features;      /* Feature flags from CPUID */
+    uint32_t start_lo;      /* TSC when the count started */
+    uint32_t start_hi;
+    uint32_t end_lo;        /* TSC when the count ran out */
+    uint32_t end_hi;
+    uint8_t control;        /* Value of the PIT control port */
+
+    memset(time_page_area, 0, sizeof(time_page_area));
+    time_page->tick_us = TICK_US;
+    time_page->quantum = QUANTUM(0);
+    CURRENT_CPU->time_page = time_page;
+
+    asm volatile ("cpuid"
+            : "=d"(features)
+            : "a"(CPUID_FEATURES)
+            : "ebx", "ecx"
+    );
+    if (!(features & CPUID_TSC))
+    {
+        return;
+    }
+
+    /* Gate channel 2 on with the speaker off, and count down once */
+    control = (inb(PIT_CONTROL_PORT) & ~PIT_CONTROL_SPEAKER) | PIT_CONTROL_GATE_2;
+    outb(control, PIT_CONTROL_PORT);
+    outb(PIT_CHANNEL_2_ONESHOT, MODE_CMD_REGISTER);
+    outb(CALIBRATE_COUNT & LOWMASK, PIT_CHANNEL_2_DATAPORT);
+    outb((CALIBRATE_COUNT & HIGHMASK) >> ONE_BYTE, PIT_CHANNEL_2_DATAPORT);
+
+    rdtsc(start_lo, start_hi);
+    while (!(inb(PIT_CONTROL_PORT) & PIT_CONTROL_OUT_2));
+    rdtsc(end_lo, end_hi);
+
+    outb(control & ~PIT_CONTROL_GATE_2, PIT_CONTROL_PORT);
+
+    /* 10ms is well under 2^32 cycles, so the low halves are enough */
+    time_page->tsc_khz = (end_lo - start_lo) / CALIBRATE_MS;
+    time_page->boot_tsc_lo = end_lo;
+    time_page->boot_tsc_hi = end_hi;
+}
+
+/*
+ * clock_init_ap
+ *   DESCRIPTION: Gives an application processor a time page of its own,
+ *                starting as a copy of the bootstrap processor's. The TSCs of
+ *                the processors are assumed to have started together, so the
+ *                calibration holds for every one.
+ *   INPUTS: cpu: The processor this runs on
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void clock_init_ap(cpu_t* cpu)
+{
+    memcpy(ap_time_page_area[cpu->id - 1], time_page_area, sizeof(time_page_area));
+    cpu->time_page = (time_page_t*)ap_time_page_area[cpu->id - 1];
+}
+
+/*
+ * clock_update
+ *   DESCRIPTION: Brings the quantum in this processor's time page up to date
+ *                for the process about to run (every process on the
+ *                processor sees the same page, so it always describes the
+ *                running one)
+ *   INPUTS: pcb: The process about to run
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void clock_update(pcb_t* pcb)
+{
+    /* Local variables */
+    time_page_t* page = CURRENT_CPU->time_page; /* This processor's time page */
+
+    page->quantum = QUANTUM(pcb->priority);
+    page->quantum_used = pcb->ticks_used;
+}
+
+/*
+ * clock_tick
+ *   DESCRIPTION: Counts a scheduler tick in every processor's time page, if it
+ *                is the bootstrap processor's. Only its ticks are counted, so
+ *                the count moves at the rate of one processor's tick no matter
+ *                how many are ticking.
+ *   INPUTS: None
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: sched_lock must be held
+ */
+void clock_tick(void)
+{
+    /* Local variables */
+    uint32_t i; /* Iteration variable */
+
+    if (CURRENT_CPU->id)
+    {
+        return;
+    }
+
+    clock_ticks++;
+    for (i = 0; i < num_cpus; i++)
+    {
+        cpus[i].time_page->ticks = clock_ticks;
+    }
+}
+
+/*
+ * clock_needs_tick
+ *   DESCRIPTION: Checks whether this processor has to keep its tick armed
+ *                even when nothing is competing for it. Without a TSC the
+ *                tick count is the only clock user programs have, so the
+ *                bootstrap processor ticks all the time (idle included)
+ *                rather than only while processes contend.
+ *   INPUTS: None
+ *   OUTPUTS: None
+ *   RETURN VALUE: 1 if the tick has to be kept armed, 0 otherwise
+ *   SIDE EFFECTS: None
+ */
+uint32_t clock_needs_tick(void)
+{
+    return !time_page->tsc_khz && !CURRENT_CPU->id;
+}
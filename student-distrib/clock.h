@@ -0,0 +1,66 @@
+/* clock.h - Defines used for the time page shared with user programs
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _CLOCK_H
+#define _CLOCK_H
+
+#include "types.h"
+#include "vm.h"
+
+/* Where every process sees the time page: right after the vidmap page, read-only */
+#define TIME_PAGE_ADDR (VIRTUAL_END + 0x1000)
+
+/* Length of a PIT tick in microseconds (25ms, see pit_drivers.h) */
+#define TICK_US 25000
+
+/* CPUID feature bit (EDX of leaf 1, see fpu.h) for the TSC */
+#define CPUID_TSC 0x00000010
+
+/* PIT channel 2, which calibrates the TSC; its gate and output are in port 0x61 */
+#define PIT_CHANNEL_2_DATAPORT 0x42
+#define PIT_CHANNEL_2_ONESHOT  0xB0 /* Channel 2, lobyte/hibyte, interrupt on terminal count */
+#define PIT_CONTROL_PORT       0x61
+#define PIT_CONTROL_GATE_2     0x01
+#define PIT_CONTROL_SPEAKER    0x02
+#define PIT_CONTROL_OUT_2      0x20
+
+/* Count the TSC is calibrated over: 10ms at the PIT's 1193182Hz */
+#define CALIBRATE_MS    10
+#define CALIBRATE_COUNT 11932
+
+/* Page the kernel keeps the time in for user programs to read without a
+ * system call; tmntsupport.h has the same layout */
+typedef struct time_page {
+    uint32_t tsc_khz;               /* TSC cycles per millisecond, or 0 if there is no TSC */
+    uint32_t boot_tsc_lo;           /* TSC when the clock was started */
+    uint32_t boot_tsc_hi;
+    uint32_t tick_us;               /* Length of a PIT tick in microseconds */
+    volatile uint32_t ticks;        /* Ticks of the bootstrap processor so far (they only keep
+                                     * time without a TSC, when it ticks even while idle) */
+    volatile uint32_t quantum;      /* Ticks in the quantum of the running process */
+    volatile uint32_t quantum_used; /* Ticks the running process has used of it */
+} time_page_t;
+
+struct pcb;
+struct cpu;
+
+/* The bootstrap processor's time page, which paging_init maps in for its processes */
+extern uint32_t time_page_area[];
+
+/* Calibrate the TSC and start the clock */
+extern void clock_init(void);
+
+/* Give an application processor a time page of its own */
+extern void clock_init_ap(struct cpu* cpu);
+
+/* Update the time page for the process about to run */
+extern void clock_update(struct pcb* pcb);
+
+/* Count a scheduler tick in the time pages */
+extern void clock_tick(void);
+
+/* Check whether this processor has to keep ticking for the time pages to keep time */
+extern uint32_t clock_needs_tick(void);
+
+#endif /* _CLOCK_H */
@@ -0,0 +1,220 @@
+/* cpu.c - Functions for the state kept separately for each processor
+ * vim:ts=4 noexpandtab
+ */
+
+#include "cpu.h"
+#include "process.h"
+#include "fpu.h"
+#include "handlers.h"
+#include "lib.h"
+#include "paging.h"
+#include "clock.h"
+#include "scheduling.h"
+
+cpu_t cpus[MAX_CPUS];
+uint32_t num_cpus = 0;
+uint8_t apic_cpu[MAX_APIC_IDS];
+
+/* Next index into cpus for an application processor to take (see smp_boot.S) */
+uint32_t ap_next_id = 1;
+
+/* Top of the boot stack of each application processor; its idle task keeps running on it */
+uint32_t ap_stacks[MAX_CPUS];
+
+/* Boot stacks of the application processors, aligned like the boot stack so
+ * that the idle task's PCB sits at the bottom of each */
+static uint8_t ap_stack_area[NUM_AP_TSS][AP_STACK_SIZE] __attribute__((aligned(AP_STACK_SIZE)));
+
+/* TSSes of the application processors (the bootstrap processor's is in x86_desc.S) */
+static tss_t ap_tss[NUM_AP_TSS];
+
+/*
+ * cpu_init
+ *   DESCRIPTION: Sets up the per-processor state of the bootstrap processor,
+ *                which starts out running the idle task on the boot stack.
+ *                The application processors are started by cpu_start_aps once
+ *                the APICs are up.
+ *   INPUTS: None
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void cpu_init(void)
+{
+    cpus[0].id = 0;
+    cpus[0].pid = IDLE_PID;
+    cpus[0].idle = BOOT_STACK_PCB;
+    cpus[0].tss = &tss;
+    cpus[0].online = 1;
+    num_cpus = 1;
+    cpu_sysenter_init(&cpus[0]);
+}
+
+/*
+ * cpu_start_aps
+ *   DESCRIPTION: Starts the application processors. Each gets an 8KB boot
+ *                stack, with its idle task's PCB at the bottom like the
+ *                bootstrap processor's, and sets itself up in ap_entry. There
+ *                is no ACPI table parsing to say how many processors there
+ *                are, so they get a fixed time to start in; ones that take
+ *                longer stay halted.
+ *   INPUTS: None
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: Must be called after apic_init and before start_scheduler.
+ *                 Takes up to 200ms. The start page below 1MB is left mapped.
+ */
+void cpu_start_aps(void)
+{
+    /* Local variables */
+    uint32_t i;       /* Iteration variable */
+    uint32_t claimed; /* Number of indices into cpus that have been taken */
+    uint32_t flags;   /* Save variable for flags */
+
+    /* The other processors can only be reached through the LAPIC */
+    if (!apic_enabled)
+    {
+        return;
+    }
+
+    cli_and_save(flags);
+
+    cpus[0].apic_id = lapic_id();
+    apic_cpu[cpus[0].apic_id] = 0;
+
+    for (i = 1; i < MAX_CPUS; i++)
+    {
+        ap_stacks[i] = (uint32_t)ap_stack_area[i - 1] + AP_STACK_SIZE;
+    }
+
+    /* Copy the start code to where it can run in real mode */
+    map_virt_to_phys((uint8_t*)AP_START_ADDR, (uint8_t*)AP_START_ADDR);
+    memcpy((void*)AP_START_ADDR, ap_start16, ap_start16_end - ap_start16);
+
+    lapic_start_aps(AP_START_ADDR);
+
+    /* Give the processors time to take their indices, then stop any more from
+     * doing so */
+    for (i = 0; (i < AP_WAIT_MS) && (ap_next_id < MAX_CPUS); i++)
+    {
+        lapic_delay(ONE_MS_US);
+    }
+    asm volatile ("xchgl %0, %1"
+            : "=r"(claimed), "+m"(ap_next_id)
+            : "0"(MAX_CPUS)
+            : "memory"
+    );
+    if (claimed > MAX_CPUS)
+    {
+        claimed = MAX_CPUS;
+    }
+
+    /* Wait for them to finish setting up. Processes are only given to the
+     * processors before the first one that doesn't. */
+    for (i = 0; i < AP_WAIT_MS; i++)
+    {
+        for (num_cpus = 1; (num_cpus < claimed) && cpus[num_cpus].online; num_cpus++);
+        if (num_cpus == claimed)
+        {
+            break;
+        }
+        lapic_delay(ONE_MS_US);
+    }
+
+    restore_flags(flags);
+}
+
+/*
+ * ap_entry
+ *   DESCRIPTION: Sets up an application processor the same way kernel.c sets
+ *                up the bootstrap processor: its TSS, the IDT, paging with its
+ *                own page directory, the FPU and its LAPIC. It then becomes
+ *                the processor's idle task.
+ *   INPUTS: id: Index of the processor in cpus, taken in smp_boot.S
+ *   OUTPUTS: None
+ *   RETURN VALUE: None; never returns
+ *   SIDE EFFECTS: Runs on the processor's boot stack with paging off
+ */
+void ap_entry(uint32_t id)
+{
+    /* Local variables */
+    cpu_t* cpu = &(cpus[id]);  /* This processor's state */
+    seg_desc_t the_tss_desc;   /* GDT entry for its TSS */
+
+    cpu->id = id;
+    cpu->apic_id = lapic_id();
+    cpu->pid = IDLE_PID;
+    cpu->idle = (pcb_t*)(ap_stacks[id] - AP_STACK_SIZE);
+    cpu->tss = &(ap_tss[id - 1]);
+    apic_cpu[cpu->apic_id] = id;
+
+    /* Construct a TSS entry in the GDT */
+    the_tss_desc.granularity   = 0x0;
+    the_tss_desc.opsize        = 0x0;
+    the_tss_desc.reserved      = 0x0;
+    the_tss_desc.avail         = 0x0;
+    the_tss_desc.seg_lim_19_16 = TSS_SIZE & 0x000F0000;
+    the_tss_desc.present       = 0x1;
+    the_tss_desc.dpl           = 0x0;
+    the_tss_desc.sys           = 0x0;
+    the_tss_desc.type          = 0x9;
+    the_tss_desc.seg_lim_15_00 = TSS_SIZE & 0x0000FFFF;
+
+    SET_TSS_PARAMS(the_tss_desc, cpu->tss, tss_size);
+
+    ap_tss_desc_ptr[id - 1] = the_tss_desc;
+
+    cpu->tss->ldt_segment_selector = KERNEL_LDT;
+    cpu->tss->ss0 = KERNEL_DS;
+    cpu->tss->esp0 = ap_stacks[id];
+    ltr(AP_TSS(id));
+    lldt(KERNEL_LDT);
+    lidt(idt_desc_ptr);
+
+    clock_init_ap(cpu);
+    paging_init_ap(cpu);
+    fpu_init();
+    lapic_init_ap();
+    cpu_sysenter_init(cpu);
+
+    cpu->online = 1;
+
+    /* Become the idle task; never returns */
+    start_scheduler_ap();
+}
+
+/*
+ * cpu_sysenter_init
+ *   DESCRIPTION: Points SYSENTER at asm_sysenter, if the processor has it. The
+ *                stack it loads is the processor's entry stack, which ends at
+ *                its pointer to the TSS, so the entry code can switch to the
+ *                kernel stack of whichever process is running. A debug trap
+ *                on the first instruction (SYSENTER leaves TF alone) is pushed
+ *                onto the entry stack rather than over anything else, and the
+ *                system call then returns with IRET to keep stepping. User
+ *                programs that don't find SYSENTER through CPUID keep using
+ *                INT $0x80.
+ *   INPUTS: cpu: The processor this runs on
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: Writes the SYSENTER MSRs
+ */
+void cpu_sysenter_init(cpu_t* cpu)
+{
+    /* Local variables */
+    uint32_t features; /* Feature flags from CPUID */
+
+    asm volatile ("cpuid"
+            : "=d"(features)
+            : "a"(CPUID_FEATURES)
+            : "ebx", "ecx"
+    );
+    if (!(features & CPUID_SEP))
+    {
+        return;
+    }
+
+    asm volatile ("wrmsr" : : "a"(KERNEL_CS), "d"(0), "c"(IA32_SYSENTER_CS));
+    asm volatile ("wrmsr" : : "a"(&(cpu->tss)), "d"(0), "c"(IA32_SYSENTER_ESP));
+    asm volatile ("wrmsr" : : "a"(asm_sysenter), "d"(0), "c"(IA32_SYSENTER_EIP));
+}
@@ -0,0 +1,99 @@
+/* cpu.h - Defines for the state kept separately for each processor
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _CPU_H
+#define _CPU_H
+
+#include "types.h"
+#include "x86_desc.h"
+
+/* CPUID feature bit (EDX of leaf 1, see fpu.h) for SYSENTER and SYSEXIT */
+#define CPUID_SEP 0x00000800
+
+/* Model specific registers SYSENTER loads CS, ESP and EIP from */
+#define IA32_SYSENTER_CS  0x174
+#define IA32_SYSENTER_ESP 0x175
+#define IA32_SYSENTER_EIP 0x176
+
+/* Size of the stack SYSENTER starts on, in words; only a trap taken before
+ * the entry code is off it is ever pushed there (see handlers_asm.S) */
+#define ENTRY_STACK_WORDS 0x10
+
+/* Most processors the kernel keeps state for (each needs its own TSS descriptor) */
+#define MAX_CPUS (NUM_AP_TSS + 1)
+
+/* Physical page the application processors start at in real mode (see smp_boot.S) */
+#define AP_START_ADDR 0x8000
+
+/* Size of the application processors' boot stacks (8KB, like the boot stack) */
+#define AP_STACK_SIZE 0x2000
+
+/* Most time to wait for the application processors to start, in milliseconds */
+#define AP_WAIT_MS 100
+#define ONE_MS_US  1000
+
+/* CR0 bit that turns on protected mode */
+#define CR0_PE 0x00000001
+
+#ifndef ASM
+
+#include "apic.h"
+
+struct pcb;
+struct terminal;
+struct time_page;
+
+/* State that belongs to one processor */
+typedef struct cpu {
+    uint32_t id;                     /* Index of the processor in the cpus array */
+    uint32_t apic_id;                /* ID of the processor's LAPIC, for sending it IPIs */
+    volatile uint32_t online;        /* Flag for whether the processor has finished starting */
+    uint32_t pid;                    /* PID of the process running on the processor */
+    struct pcb* idle;                /* PCB of the processor's idle task, at the bottom of its boot stack */
+    uint32_t entry_stack[ENTRY_STACK_WORDS]; /* Stack SYSENTER starts on, which ends at tss below */
+    tss_t* tss;                      /* TSS holding the processor's kernel stack for interrupts from user mode */
+    uint32_t* page_directory;        /* Page directory the processor runs with (see paging.c) */
+    struct time_page* time_page;     /* Time page the processor's processes see (see clock.c) */
+    struct pcb* fpu_owner;           /* Process whose FPU/SSE state is in the processor's registers (NULL for none) */
+    volatile uint32_t tick_pending;  /* Flag for whether the processor's tick is armed but hasn't fired */
+    uint32_t nr_processes;           /* Processes that belong to the processor, running or not */
+    struct terminal* shell_terminal; /* Terminal the idle task is starting a base shell on (NULL otherwise) */
+    struct pcb* dead;                /* Process that exited and is waiting to be freed after the switch (NULL for none) */
+} cpu_t;
+
+/* State of every processor that is running the kernel */
+extern cpu_t cpus[MAX_CPUS];
+
+/* Number of processors that are running the kernel */
+extern uint32_t num_cpus;
+
+/* Index into cpus of the processor with each LAPIC ID */
+extern uint8_t apic_cpu[MAX_APIC_IDS];
+
+/* Real mode start code of the application processors (see smp_boot.S) */
+extern uint8_t ap_start16[];
+extern uint8_t ap_start16_end[];
+
+/* The processor this runs on, told apart by its LAPIC ID (without the APICs
+ * only the bootstrap processor runs) */
+#define CURRENT_CPU (&(cpus[apic_enabled ? apic_cpu[lapic_id()] : 0]))
+
+/* PID of the process running on this processor */
+#define CURRENT_PID (CURRENT_CPU->pid)
+
+/* Set up the state of the bootstrap processor */
+extern void cpu_init(void);
+
+/* Start the application processors, which wait in their idle tasks for the scheduler */
+extern void cpu_start_aps(void);
+
+/* C entry point of an application processor, called by smp_boot.S on its boot stack */
+extern void ap_entry(uint32_t id);
+
+/* Set up SYSENTER system calls on this processor, if it has them */
+extern void cpu_sysenter_init(cpu_t* cpu);
+
+#endif /* ASM */
+
+#endif /* _CPU_H */
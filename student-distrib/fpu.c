@@ -0,0 +1,212 @@
+/* fpu.c - Functions for lazily switching FPU/SSE state between processes
+ * vim:ts=4 noexpandtab
+ */
+
+#include "fpu.h"
+#include "lib.h"
+#include "x86_desc.h"
+#include "handlers.h"
+
+/* Each processor's registers hold the state of its own fpu_owner (see cpu.h);
+ * processes never move between processors, so the state is never in another's registers */
+
+/* Flag for whether the processor supports FXSAVE and SSE */
+static uint32_t fpu_available = 0;
+
+/* Set and clear CR0.TS */
+#define stts() do {                         \
+    asm volatile ("                       \n\
+            movl %%cr0, %%eax             \n\
+            orl  %0, %%eax                \n\
+            movl %%eax, %%cr0             \n\
+            "                               \
+            :                               \
+            : "i"(CR0_TS)                   \
+            : "eax", "memory", "cc"         \
+    );                                      \
+} while (0)
+
+#define clts() do {                         \
+    asm volatile ("clts" : : : "memory");   \
+} while (0)
+
+/*
+ * fpu_init
+ *   DESCRIPTION: Enables the FPU and SSE if the processor supports FXSAVE. No
+ *                process owns the registers yet, so TS is set to trap the first
+ *                FPU instruction. If FXSAVE isn't supported the FPU is left
+ *                emulated, so any use of it is an exception.
+ *   INPUTS: None
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: Modifies CR0 and CR4
+ */
+void fpu_init(void)
+{
+    /* Local variables */
+    uint32_t features; /* Feature flags from CPUID */
+    uint32_t cr;       /* Copy of a control register */
+    
+    asm volatile ("cpuid"
+            : "=d"(features)
+            : "a"(CPUID_FEATURES)
+            : "ebx", "ecx"
+    );
+    
+    CURRENT_CPU->fpu_owner = NULL;
+    fpu_available = ((features & CPUID_FXSR) && (features & CPUID_SSE));
+    
+    if (fpu_available)
+    {
+        asm volatile ("movl %%cr4, %0" : "=r"(cr));
+        cr |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+        asm volatile ("movl %0, %%cr4" : : "r"(cr));
+        
+        asm volatile ("movl %%cr0, %0" : "=r"(cr));
+        cr &= ~CR0_EM;
+        cr |= CR0_MP | CR0_NE | CR0_TS;
+        asm volatile ("movl %0, %%cr0" : : "r"(cr));
+    }
+    else
+    {
+        asm volatile ("movl %%cr0, %0" : "=r"(cr));
+        cr |= CR0_EM | CR0_TS;
+        asm volatile ("movl %0, %%cr0" : : "r"(cr));
+    }
+}
+
+/*
+ * fpu_trap
+ *   DESCRIPTION: Called on the device not available exception, which happens
+ *                the first time a process touches the FPU after being switched
+ *                to. Saves the state of the process that last used the FPU and
+ *                loads the current process's (or a clean state on its first use).
+ *   INPUTS: None
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: Halts the process if there is no usable FPU
+ */
+void fpu_trap(void)
+{
+    /* Local variables */
+    pcb_t* pcb;     /* The process that trapped */
+    cpu_t* cpu;     /* The processor it runs on */
+    uint32_t mxcsr; /* Initial value of MXCSR */
+    uint32_t flags; /* Save variable for flags */
+    
+    /* The kernel itself never uses the FPU */
+    if (!fpu_available || (CURRENT_PID == IDLE_PID))
+    {
+        handle_coprocessor_not_available();
+        return;
+    }
+    
+    /* Start critical section */
+    cli_and_save(flags);
+    
+    pcb = CURRENT_PCB_ADDRESS;
+    cpu = CURRENT_CPU;
+    clts();
+    
+    if (cpu->fpu_owner != pcb)
+    {
+        if (cpu->fpu_owner)
+        {
+            asm volatile ("fxsave %0" : "=m"(cpu->fpu_owner->fpu_state));
+        }
+        
+        if (pcb->fpu_used)
+        {
+            asm volatile ("fxrstor %0" : : "m"(pcb->fpu_state));
+        }
+        else
+        {
+            mxcsr = MXCSR_DEFAULT;
+            asm volatile ("fninit; ldmxcsr %0" : : "m"(mxcsr));
+            pcb->fpu_used = TRUE;
+        }
+        
+        cpu->fpu_owner = pcb;
+    }
+    
+    /* End critical section */
+    restore_flags(flags);
+}
+
+/*
+ * fpu_switch_to
+ *   DESCRIPTION: Called whenever another process is about to run. If the
+ *                registers already hold its state it can use the FPU freely,
+ *                otherwise TS is set so that its first FPU instruction traps.
+ *   INPUTS: next: The process about to run
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: Modifies CR0.TS
+ */
+void fpu_switch_to(pcb_t* next)
+{
+    if (!fpu_available)
+    {
+        return;
+    }
+    
+    if (next == CURRENT_CPU->fpu_owner)
+    {
+        clts();
+    }
+    else
+    {
+        stts();
+    }
+}
+
+/*
+ * fpu_release
+ *   DESCRIPTION: Throws away the FPU/SSE state of a process that is halting,
+ *                so it isn't saved into a PCB that is no longer in use
+ *   INPUTS: pcb: The halting process
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void fpu_release(pcb_t* pcb)
+{
+    if (cpus[pcb->cpu].fpu_owner == pcb)
+    {
+        cpus[pcb->cpu].fpu_owner = NULL;
+    }
+    pcb->fpu_used = FALSE;
+}
+
+/*
+ * fpu_copy
+ *   DESCRIPTION: Gives a forked child a copy of its parent's FPU/SSE state,
+ *                saving it from the registers if the parent's state is loaded
+ *   INPUTS: child: The new process
+ *           parent: The process forking, which must be the current one
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void fpu_copy(pcb_t* child, pcb_t* parent)
+{
+    /* Local variables */
+    uint32_t flags; /* Save variable for flags */
+    
+    /* Start critical section */
+    cli_and_save(flags);
+    
+    child->fpu_used = parent->fpu_used;
+    if (CURRENT_CPU->fpu_owner == parent)
+    {
+        /* TS is clear while the owner runs, so this can't trap */
+        asm volatile ("fxsave %0" : "=m"(child->fpu_state));
+    }
+    else if (parent->fpu_used)
+    {
+        memcpy(child->fpu_state, parent->fpu_state, FPU_STATE_SIZE);
+    }
+    
+    /* End critical section */
+    restore_flags(flags);
+}
@@ -0,0 +1,42 @@
+/* fpu.h - Defines used for lazily switching FPU/SSE state between processes
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _FPU_H
+#define _FPU_H
+
+#include "types.h"
+#include "process.h"
+
+/* CPUID feature bits (EDX of leaf 1) needed for FXSAVE and SSE */
+#define CPUID_FEATURES 0x01
+#define CPUID_FXSR     0x01000000
+#define CPUID_SSE      0x02000000
+
+/* Control register bits */
+#define CR0_MP         0x00000002 /* Monitor coprocessor: WAIT/FWAIT also trap on TS */
+#define CR0_EM         0x00000004 /* Emulation: every FPU instruction traps */
+#define CR0_TS         0x00000008 /* Task switched: the next FPU instruction traps */
+#define CR0_NE         0x00000020 /* Report FPU errors through exception 16 */
+#define CR4_OSFXSR     0x00000200 /* The OS saves SSE state with FXSAVE */
+#define CR4_OSXMMEXCPT 0x00000400 /* The OS handles SIMD exceptions (exception 19) */
+
+/* Power-on value of MXCSR: every SIMD exception masked, round to nearest */
+#define MXCSR_DEFAULT  0x1F80
+
+/* Enable the FPU and SSE, leaving them to trap on first use */
+extern void fpu_init(void);
+
+/* Handler for the device not available exception; loads the current process's state */
+extern void fpu_trap(void);
+
+/* Set up CR0.TS so that the next process only traps if its state isn't loaded */
+extern void fpu_switch_to(pcb_t* next);
+
+/* Give a forked child a copy of its parent's FPU/SSE state */
+extern void fpu_copy(pcb_t* child, pcb_t* parent);
+
+/* Forget the FPU/SSE state of a process that is going away */
+extern void fpu_release(pcb_t* pcb);
+
+#endif /* _FPU_H */
@@ -0,0 +1,364 @@
+/* frame.c - Functions for allocating physical memory frames
+ * vim:ts=4 noexpandtab
+ */
+
+#include "frame.h"
+#include "lib.h"
+#include "spinlock.h"
+
+/* A free block smaller than 4MB; the links live in the block itself */
+typedef struct free_block {
+    struct free_block* next;
+    struct free_block* prev;
+} free_block_t;
+
+/* Stacks of the free 4MB frames' physical addresses. Low frames are identity
+ * mapped and get split into smaller blocks, so 4MB allocations prefer high ones. */
+static uint32_t low_frames[MAX_FRAMES];
+static uint32_t num_low_frames = 0;
+static uint32_t high_frames[MAX_FRAMES];
+static uint32_t num_high_frames = 0;
+
+/* Free blocks of each order below 4MB */
+static free_block_t* free_lists[FRAME_ORDER_4M];
+
+/* For each page of low memory, BLOCK_FREE | order if a free block starts there, otherwise 0 */
+static uint8_t page_state[DIRECT_MAP_PAGES];
+
+/* For each page of low memory, how many mappings of it there are beyond the first */
+static uint16_t page_shares[DIRECT_MAP_PAGES];
+
+/* Lock protecting the free stacks, the free lists, page_state and page_shares */
+static spinlock_t frame_lock = SPINLOCK_UNLOCKED;
+
+static void add_frames(uint32_t first, uint32_t end, uint32_t lowest);
+static void push_frame(uint32_t frame);
+static void list_add(uint32_t block, uint32_t order);
+static void list_remove(uint32_t block, uint32_t order);
+
+/*
+ * frame_init
+ *   DESCRIPTION: Puts every frame of usable RAM above the kernel and the boot
+ *                modules on the free stack. The BIOS memory map is used if the
+ *                boot loader gave one, otherwise the upper memory size.
+ *   INPUTS: mbi: The multiboot info from the boot loader
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: Must be called before paging is enabled, since the multiboot
+ *                 info isn't mapped afterwards
+ */
+void frame_init(multiboot_info_t* mbi)
+{
+    /* Local variables */
+    memory_map_t* mmap; /* Iteration variable for the memory map */
+    module_t* mod;      /* Iteration variable for the boot modules */
+    uint32_t lowest;    /* Lowest address a frame can start at */
+    uint32_t end;       /* Frame number just past the end of a region */
+    uint32_t i;
+
+    /* Frames must not overlap a boot module (normally they all sit below 8MB) */
+    lowest = FIRST_FRAME;
+    if (mbi->flags & MBI_FLAG_MODS)
+    {
+        mod = (module_t*)mbi->mods_addr;
+        for (i = 0; i < mbi->mods_count; i++, mod++)
+        {
+            if (mod->mod_end > lowest)
+            {
+                lowest = mod->mod_end;
+            }
+        }
+    }
+
+    num_low_frames = 0;
+    num_high_frames = 0;
+    for (i = 0; i < FRAME_ORDER_4M; i++)
+    {
+        free_lists[i] = NULL;
+    }
+    memset(page_state, 0, sizeof(page_state));
+
+    if (mbi->flags & MBI_FLAG_MMAP)
+    {
+        for (mmap = (memory_map_t*)mbi->mmap_addr;
+                (uint32_t)mmap < mbi->mmap_addr + mbi->mmap_length;
+                mmap = (memory_map_t*)((uint32_t)mmap + mmap->size + sizeof(mmap->size)))
+        {
+            /* Only usable RAM below 4GB */
+            if ((mmap->type != MMAP_AVAILABLE) || mmap->base_addr_high)
+            {
+                continue;
+            }
+
+            /* Regions that run past 4GB are cut off there */
+            if (mmap->length_high || (mmap->base_addr_low + mmap->length_low < mmap->base_addr_low))
+            {
+                end = MAX_FRAMES;
+            }
+            else
+            {
+                end = (mmap->base_addr_low + mmap->length_low) >> FRAME_SHIFT;
+            }
+
+            add_frames(mmap->base_addr_low, end, lowest);
+        }
+    }
+    else if (mbi->flags & MBI_FLAG_MEM)
+    {
+        /* mem_upper is the number of KB of RAM above 1MB */
+        add_frames(UPPER_MEMORY_START, (UPPER_MEMORY_START + (mbi->mem_upper << KB_SHIFT)) >> FRAME_SHIFT, lowest);
+    }
+}
+
+/*
+ * add_frames
+ *   DESCRIPTION: Puts the whole frames of a region of RAM on the free stack
+ *   INPUTS: first: Physical address the region starts at
+ *           end: Frame number just past the end of the region
+ *           lowest: Lowest address a frame can start at
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+static void add_frames(uint32_t first, uint32_t end, uint32_t lowest)
+{
+    uint32_t frame; /* Frame number being added */
+
+    if (first < lowest)
+    {
+        first = lowest;
+    }
+
+    /* Round up to the first whole frame; the highest frame is popped last */
+    frame = (first >> FRAME_SHIFT) + ((first & (FRAME_SIZE - 1)) ? 1 : 0);
+    if (end > MAX_FRAMES)
+    {
+        end = MAX_FRAMES;
+    }
+    while (end > frame)
+    {
+        end--;
+        push_frame(end << FRAME_SHIFT);
+    }
+}
+
+/*
+ * push_frame
+ *   DESCRIPTION: Puts a free 4MB frame on the stack for where it is in memory
+ *   INPUTS: frame: Physical address of the frame
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: frame_lock must be held (or the allocator not yet in use)
+ */
+static void push_frame(uint32_t frame)
+{
+    if (frame < DIRECT_MAP_END)
+    {
+        low_frames[num_low_frames++] = frame;
+    }
+    else
+    {
+        high_frames[num_high_frames++] = frame;
+    }
+}
+
+/*
+ * list_add
+ *   DESCRIPTION: Adds a free block to the free list for its order
+ *   INPUTS: block: Physical (and virtual) address of the block
+ *           order: Order of the block
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: frame_lock must be held
+ */
+static void list_add(uint32_t block, uint32_t order)
+{
+    free_block_t* entry = (free_block_t*)block;
+
+    entry->prev = NULL;
+    entry->next = free_lists[order];
+    if (entry->next)
+    {
+        entry->next->prev = entry;
+    }
+    free_lists[order] = entry;
+    page_state[block >> PAGE_SHIFT] = BLOCK_FREE | order;
+}
+
+/*
+ * list_remove
+ *   DESCRIPTION: Takes a free block off the free list for its order
+ *   INPUTS: block: Physical (and virtual) address of the block
+ *           order: Order of the block
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: frame_lock must be held
+ */
+static void list_remove(uint32_t block, uint32_t order)
+{
+    free_block_t* entry = (free_block_t*)block;
+
+    if (entry->prev)
+    {
+        entry->prev->next = entry->next;
+    }
+    else
+    {
+        free_lists[order] = entry->next;
+    }
+    if (entry->next)
+    {
+        entry->next->prev = entry->prev;
+    }
+    page_state[block >> PAGE_SHIFT] = 0;
+}
+
+/*
+ * frame_alloc
+ *   DESCRIPTION: Allocates a frame with the buddy system. 4MB frames come off
+ *                the free stacks (high memory first). Smaller frames come from
+ *                the smallest free block that fits, splitting a low 4MB frame
+ *                if there is none, and are identity mapped for the kernel.
+ *   INPUTS: order: The frame is 4KB << order
+ *   OUTPUTS: None
+ *   RETURN VALUE: Physical address of the frame, or 0 if there is no memory left
+ *   SIDE EFFECTS: None
+ */
+uint32_t frame_alloc(uint32_t order)
+{
+    /* Local variables */
+    uint32_t block = 0; /* Address of the block being allocated */
+    uint32_t size;      /* Order of the block being split */
+    uint32_t flags;     /* Save variable for flags */
+
+    if (order > FRAME_ORDER_4M)
+    {
+        return 0;
+    }
+
+    spin_lock_irqsave(&frame_lock, flags);
+
+    if (order == FRAME_ORDER_4M)
+    {
+        if (num_high_frames)
+        {
+            block = high_frames[--num_high_frames];
+        }
+        else if (num_low_frames)
+        {
+            block = low_frames[--num_low_frames];
+        }
+        spin_unlock_irqrestore(&frame_lock, flags);
+        return block;
+    }
+
+    /* Find the smallest free block that is big enough */
+    for (size = order; (size < FRAME_ORDER_4M) && !free_lists[size]; size++);
+    if (size < FRAME_ORDER_4M)
+    {
+        block = (uint32_t)free_lists[size];
+        list_remove(block, size);
+    }
+    else if (num_low_frames)
+    {
+        block = low_frames[--num_low_frames];
+    }
+    else
+    {
+        spin_unlock_irqrestore(&frame_lock, flags);
+        return 0;
+    }
+
+    /* Split it in half until it's the right size, freeing the upper halves */
+    while (size > order)
+    {
+        size--;
+        list_add(block + ORDER_SIZE(size), size);
+    }
+
+    spin_unlock_irqrestore(&frame_lock, flags);
+    return block;
+}
+
+/*
+ * frame_free
+ *   DESCRIPTION: Frees a frame, merging it with its buddy for as long as the
+ *                buddy is free too. A block that grows back to 4MB goes back
+ *                on the free stack. A 4KB frame that is still shared just
+ *                loses one mapping.
+ *   INPUTS: frame: Physical address of the frame
+ *           order: The frame is 4KB << order
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void frame_free(uint32_t frame, uint32_t order)
+{
+    /* Local variables */
+    uint32_t buddy; /* Address of the block the frame was split from */
+    uint32_t flags; /* Save variable for flags */
+
+    spin_lock_irqsave(&frame_lock, flags);
+
+    if ((order == FRAME_ORDER_4K) && (frame < DIRECT_MAP_END) && page_shares[frame >> PAGE_SHIFT])
+    {
+        page_shares[frame >> PAGE_SHIFT]--;
+        spin_unlock_irqrestore(&frame_lock, flags);
+        return;
+    }
+
+    while (order < FRAME_ORDER_4M)
+    {
+        buddy = frame ^ ORDER_SIZE(order);
+        if (page_state[buddy >> PAGE_SHIFT] != (BLOCK_FREE | order))
+        {
+            break;
+        }
+        list_remove(buddy, order);
+        frame &= ~ORDER_SIZE(order);
+        order++;
+    }
+
+    if (order == FRAME_ORDER_4M)
+    {
+        push_frame(frame);
+    }
+    else
+    {
+        list_add(frame, order);
+    }
+
+    spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/*
+ * frame_share
+ *   DESCRIPTION: Records another mapping of a 4KB frame, so that it takes one
+ *                more frame_free to actually free it
+ *   INPUTS: frame: Physical address of the frame
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void frame_share(uint32_t frame)
+{
+    uint32_t flags;
+
+    spin_lock_irqsave(&frame_lock, flags);
+    page_shares[frame >> PAGE_SHIFT]++;
+    spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/*
+ * frame_shared
+ *   DESCRIPTION: Checks whether a 4KB frame has more than one mapping. A
+ *                mapping that finds it isn't shared owns the frame outright.
+ *   INPUTS: frame: Physical address of the frame
+ *   OUTPUTS: None
+ *   RETURN VALUE: Nonzero if the frame is shared
+ *   SIDE EFFECTS: None
+ */
+uint32_t frame_shared(uint32_t frame)
+{
+    return page_shares[frame >> PAGE_SHIFT];
+}
@@ -0,0 +1,61 @@
+/* frame.h - Defines used for allocating physical memory frames
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _FRAME_H
+#define _FRAME_H
+
+#include "types.h"
+#include "multiboot.h"
+
+/* Frames come in power of two multiples of 4KB, from 4KB pages up to the 4MB
+ * pages user programs and kernel stacks are mapped with */
+#define PAGE_SHIFT 12
+#define FRAME_ORDER_4K 0
+#define FRAME_ORDER_4M 10
+#define FRAME_SIZE 0x400000
+#define FRAME_SHIFT 22
+#define ORDER_SIZE(order) ((uint32_t)0x1000 << (order))
+
+/* Physical memory below here is identity mapped for the kernel (up to where user
+ * space starts), so frames smaller than 4MB are only split out of it */
+#define DIRECT_MAP_END 0x8000000
+#define DIRECT_MAP_PAGES (DIRECT_MAP_END >> PAGE_SHIFT)
+
+/* page_state value for the first page of a free block smaller than 4MB (OR'd with its order) */
+#define BLOCK_FREE 0x80
+
+/* Memory below 8MB holds the kernel, its boot stack and the boot modules */
+#define FIRST_FRAME 0x800000
+
+/* Most 4MB frames a 32-bit physical address space can hold */
+#define MAX_FRAMES 0x400
+
+/* Flags in the multiboot info for which of its fields are valid */
+#define MBI_FLAG_MEM  0x01
+#define MBI_FLAG_MODS 0x08
+#define MBI_FLAG_MMAP 0x40
+
+/* Without a memory map, mem_upper is the number of KB of RAM from here */
+#define UPPER_MEMORY_START 0x100000
+#define KB_SHIFT 10
+
+/* Type of the memory map entries that describe usable RAM */
+#define MMAP_AVAILABLE 0x01
+
+/* Find the usable frames in the multiboot memory map */
+extern void frame_init(multiboot_info_t* mbi);
+
+/* Allocate a frame of 4KB << order; returns its physical address, or 0 if memory is full */
+extern uint32_t frame_alloc(uint32_t order);
+
+/* Give back a frame of 4KB << order (a shared 4KB frame just loses one mapping) */
+extern void frame_free(uint32_t frame, uint32_t order);
+
+/* Record another mapping of a 4KB frame, for copy-on-write */
+extern void frame_share(uint32_t frame);
+
+/* Check whether a 4KB frame is mapped more than once */
+extern uint32_t frame_shared(uint32_t frame);
+
+#endif /* _FRAME_H */
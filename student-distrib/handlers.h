@@ -0,0 +1,36 @@
+
+#define GENERIC_EXCEPTIONS 32
+#define SYS_CALL 0x80
+#define PIT_INTERRUPT 0x20
+#define KEYBOARD_INTERRUPT 0x21
+#define RTC_INTERRUPT 0x28
+#define HARDWARE_EXCEPTIONS 22
+#define PAGE_FAULT 0x0E
+#define MOUSE_INTERRUPT 0x2C
+#define RESCHEDULE_INTERRUPT 0xF0
+#define REMAP_INTERRUPT 0xF1
+#define APIC_SPURIOUS_INTERRUPT 0xFF
+
+extern void fill_idt();
+extern void emptyfunc();
+
+
+typedef void (*handler)();
+
+// 22 Exceptions defined by Intel, plus a generic exception
+extern handler exception_jumptable[23];
+
+extern void asm_generic_system_call();
+extern void asm_sysenter();
+extern void asm_generic_keyboard_interrupt();
+extern void asm_generic_exception();
+extern void asm_generic_RTC_interrupt();
+extern void asm_pit_interrupt();
+extern void asm_generic_mouse_interrupt();
+extern void asm_apic_spurious_interrupt();
+extern void asm_reschedule_interrupt();
+extern void asm_remap_interrupt();
+
+extern void handle_coprocessor_not_available();
+
+void set_bits(idt_desc_t * entry);
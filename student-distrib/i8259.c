@@ -4,11 +4,16 @@
 
 #include "i8259.h"
 #include "lib.h"
+#include "spinlock.h"
+#include "apic.h"
 
 /* Interrupt masks to determine which interrupts are enabled and disabled */
 uint8_t master_mask; /* IRQs 0-7  */
 uint8_t slave_mask;  /* IRQs 8-15 */
 
+/* Lock protecting the PIC's ports */
+static spinlock_t pic_lock = SPINLOCK_UNLOCKED;
+
 /* Initialize the 8259 PIC 
  * http://wiki.osdev.org/8259_PIC 
  * Inputs: None
@@ -63,14 +68,20 @@ void i8259_init(void)
  *  http://wiki.osdev.org/8259_PIC 
  * Inputs: an IRQ
  * Outputs: None
- * Enables (unmasks) the specified IRQ */
+ * Enables (unmasks) the specified IRQ, on the IO-APIC once it has taken over */
 void enable_irq(uint32_t irq_num)
 {
     uint8_t port;
     uint8_t value;
     uint32_t flags;
     
-    cli_and_save(flags);
+    if (apic_enabled)
+    {
+        ioapic_enable_irq(irq_num);
+        return;
+    }
+    
+    spin_lock_irqsave(&pic_lock, flags);
     
     if(irq_num < SLAVE_IRQ_START)
     {
@@ -84,21 +95,27 @@ void enable_irq(uint32_t irq_num)
     value = inb(port) & ~(1 << irq_num);
     outb(value, port);
     
-    restore_flags(flags);
+    spin_unlock_irqrestore(&pic_lock, flags);
 }
 
 /* disable_irq
  * http://wiki.osdev.org/8259_PIC 
  * Inputs: an IRQ
  * Outputs: None
- * Disables (masks) the specified IRQ */
+ * Disables (masks) the specified IRQ, on the IO-APIC once it has taken over */
 void disable_irq(uint32_t irq_num)
 {
     uint8_t port;
     uint8_t value;
     uint32_t flags;
     
-    cli_and_save(flags);
+    if (apic_enabled)
+    {
+        ioapic_disable_irq(irq_num);
+        return;
+    }
+    
+    spin_lock_irqsave(&pic_lock, flags);
     
     if(irq_num < SLAVE_IRQ_START)
     {
@@ -112,17 +129,25 @@ void disable_irq(uint32_t irq_num)
     value = inb(port) | (1 << irq_num);
     outb(value, port);
     
-    restore_flags(flags);
+    spin_unlock_irqrestore(&pic_lock, flags);
 }
 
 /* Send end-of-interrupt signal for the specified IRQ */
 /* http://wiki.osdev.org/8259_PIC */
+/* Once the APICs have taken over this is a single LAPIC store, which ends
+ * whichever interrupt is in service (interrupts don't nest, so that is irq_num) */
 void send_eoi(uint32_t irq_num)
 {
     uint8_t eoi;
     uint32_t flags;
     
-    cli_and_save(flags);
+    if (apic_enabled)
+    {
+        lapic_eoi();
+        return;
+    }
+    
+    spin_lock_irqsave(&pic_lock, flags);
     
     if(irq_num >= SLAVE_IRQ_START)
     {
@@ -137,5 +162,5 @@ void send_eoi(uint32_t irq_num)
         outb(eoi, MASTER_8259_PORT);
     }
     
-    restore_flags(flags);
+    spin_unlock_irqrestore(&pic_lock, flags);
 }
@@ -6,6 +6,7 @@
 #include "x86_desc.h"
 #include "lib.h"
 #include "i8259.h"
+#include "apic.h"
 #include "rtc.h"
 #include "terminal.h"
 #include "debug.h"
@@ -16,10 +17,13 @@
 #include "sys_call.h"
 #include "pit_drivers.h"
 #include "scheduling.h"
-#include "jank_malloc.h"
 #include "process.h"
+#include "frame.h"
+#include "fpu.h"
+#include "cpu.h"
 #include "mouse.h"
 #include "modex.h"
+#include "clock.h"
 
 #define RUN_TESTS 0
 #define USE_SCHEDULING 1
@@ -154,18 +158,39 @@ void entry(unsigned long magic, unsigned long addr) {
         ltr(KERNEL_TSS);
     }
     
+    /* Set up the bootstrap processor's state */
+    cpu_init();
+    
+    /* Find the free RAM while the multiboot info is still reachable */
+    frame_init(mbi);
+    
    // Fill and load the IDT
    fill_idt();
    lidt(idt_desc_ptr);
    
 
     paging_init();                         //at location 4MB (=2^22 = 0x400000) in memory
+    
+    /* Set up the PID allocator (its PCB cache takes memory once paging is on) */
+    process_init();
+
+    /* Enable the FPU and SSE for user programs */
+    fpu_init();
+
+    /* Start the clock user programs read from the time page */
+    clock_init();
 
     //init_file_io();
     /* Init the PIC */
         
     i8259_init();
     
+    /* Deliver interrupts through the APICs if there are any */
+    apic_init();
+    
+    /* Start the application processors, which wait for the scheduler in their idle tasks */
+    cpu_start_aps();
+    
     mouse_init();
 
     /* Initialize devices, memory, filesystem, enable device interrupts on the
@@ -181,8 +206,6 @@ void entry(unsigned long magic, unsigned long addr) {
      * without showing you any output */
     //sti();
     
-    test_malloc();
-    test_free();
      
 
 
@@ -22,16 +22,50 @@
 #define VGA_CURSOR_LOW     0x0F
 #define VGA_CURSOR_HIGH    0x0E
 
-static int screen_x;
-static int screen_y;
+/* Where the screen functions print: a terminal, or the boot console */
+typedef struct screen {
+    uint8_t* video_mem; /* Video memory if it's on the display, its backing page otherwise */
+    uint32_t* x;        /* Coords of the current display location */
+    uint32_t* y;
+    uint32_t shown;     /* Flag for whether the cursor follows it (the idle task's printing doesn't move it) */
+} screen_t;
+
+/* The boot console, printed to before scheduling starts and by the idle task */
+static uint32_t screen_x;
+static uint32_t screen_y;
 static int cursor_x;
 static int cursor_y;
 static int32_t mouse_x = (NUM_COLS + 1) / 2;
 static int32_t mouse_y = (NUM_ROWS + 1) / 2;
 static uint8_t* video_mem = (uint8_t *)VIDEO;
 
-static void scroll_display(void);
+static void get_screen(screen_t* screen);
+static void scroll_display(screen_t* screen);
 static void scroll_display_active(void);
+static void put_char(screen_t* screen, uint8_t c);
+static void put_done(screen_t* screen);
+
+/* static void get_screen(screen_t* screen);
+ * Inputs: screen_t* screen = filled in with the current screen
+ * Return Value: void
+ *  Function: Finds where this processor prints. A process prints to its
+ *            terminal's storage directly, so processes on different
+ *            processors don't share any coords or mappings. */
+static void get_screen(screen_t* screen) {
+    terminal_t* terminal = scheduling_started ? CURRENT_PCB_ADDRESS->terminal : NULL;
+    
+    if (terminal) {
+        screen->video_mem = terminal->active ? (uint8_t*)VIDEO : (uint8_t*)terminal->video_backing;
+        screen->x = &(terminal->screen_x);
+        screen->y = &(terminal->screen_y);
+        screen->shown = terminal->active;
+    } else {
+        screen->video_mem = video_mem;
+        screen->x = &screen_x;
+        screen->y = &screen_y;
+        screen->shown = !scheduling_started;
+    }
+}
 
 /* void clear(void);
  * Inputs: void
@@ -39,9 +73,12 @@ static void scroll_display_active(void);
  * Function: Clears video memory */
 void clear(void) {
     int32_t i;
+    screen_t screen;
+    
+    get_screen(&screen);
     for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-        *(uint8_t *)(video_mem + (i << 1)) = ' ';
-        *(uint8_t *)(video_mem + (i << 1) + 1) = ATTRIB;
+        *(uint8_t *)(screen.video_mem + (i << 1)) = ' ';
+        *(uint8_t *)(screen.video_mem + (i << 1) + 1) = ATTRIB;
     }
 }
 
@@ -201,44 +238,75 @@ int32_t puts(int8_t* s) {
  * Return Value: void
  *  Function: Output a character to the console */
 void putc(uint8_t c) {
+    screen_t screen;
+    
+    get_screen(&screen);
+    put_char(&screen, c);
+    put_done(&screen);
+}
+
+/* void putn(const uint8_t* s, int32_t n);
+ * Inputs: const uint8_t* s = characters to print
+ *         int32_t n = number of characters
+ * Return Value: void
+ *  Function: Output a span of characters to the console, moving the cursor
+ *            once at the end rather than after each one */
+void putn(const uint8_t* s, int32_t n) {
+    int32_t i;
+    screen_t screen;
+    
+    get_screen(&screen);
+    for (i = 0; i < n; i++) {
+        put_char(&screen, s[i]);
+    }
+    put_done(&screen);
+}
+
+/* static void put_char(screen_t* screen, uint8_t c);
+ * Inputs: screen_t* screen = the screen to print to
+ *         uint8_t c = character to print
+ * Return Value: void
+ *  Function: Puts a character on the screen, without moving the cursor */
+static void put_char(screen_t* screen, uint8_t c) {
     if(c == '\n' || c == '\r') {
-        screen_y++;
-        screen_x = 0;
+        (*screen->y)++;
+        *screen->x = 0;
     } else if (c == '\b') {
-        screen_x--;
-        if (!(~screen_x))
+        (*screen->x)--;
+        if (!(~*screen->x))
         {
             /* Check for 0 */
-            screen_y--;
-            screen_x += NUM_COLS;
+            (*screen->y)--;
+            *screen->x += NUM_COLS;
         }
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = BLANK_CHAR;
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB;
+        *(uint8_t *)(screen->video_mem + ((NUM_COLS * *screen->y + *screen->x) << 1)) = BLANK_CHAR;
+        *(uint8_t *)(screen->video_mem + ((NUM_COLS * *screen->y + *screen->x) << 1) + 1) = ATTRIB;
     } else {
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = c;
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB;
-        screen_x++;
-        if (!(screen_x %= NUM_COLS))
+        *(uint8_t *)(screen->video_mem + ((NUM_COLS * *screen->y + *screen->x) << 1)) = c;
+        *(uint8_t *)(screen->video_mem + ((NUM_COLS * *screen->y + *screen->x) << 1) + 1) = ATTRIB;
+        (*screen->x)++;
+        if (!(*screen->x %= NUM_COLS))
         {
-            screen_y++;
+            (*screen->y)++;
         }
         //screen_y = (screen_y + (screen_x / NUM_COLS)) % NUM_ROWS;
     }
     
-    if (screen_y == NUM_ROWS)
+    if (*screen->y == NUM_ROWS)
     {
-        scroll_display();
+        scroll_display(screen);
     }
-    
-    if (scheduling_started)
+}
+
+/* static void put_done(screen_t* screen);
+ * Inputs: screen_t* screen = the screen that was printed to
+ * Return Value: void
+ *  Function: Moves the cursor to where printing left off, if the screen
+ *            is on the display */
+static void put_done(screen_t* screen) {
+    if (screen->shown)
     {
-        if (CURRENT_TASK.terminal->active)
-        {
-            update_cursor();
-        }
-        
-        CURRENT_TASK.terminal->screen_x = screen_x;
-        CURRENT_TASK.terminal->screen_y = screen_y;
+        update_cursor();
     }
 }
 
@@ -567,8 +635,11 @@ int8_t* strncpy(int8_t* dest, const int8_t* src, uint32_t n) {
  * Function: increments video memory. To be used to test rtc */
 void test_interrupts(void) {
     int32_t i;
+    screen_t screen;
+    
+    get_screen(&screen);
     for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-        video_mem[i << 1]++;
+        screen.video_mem[i << 1]++;
     }
 }
 
@@ -580,11 +651,14 @@ void test_interrupts(void) {
 void update_cursor(void)
 {
     /* Local Variables */
-    uint16_t pos; /* Row major position of the cursor */
+    uint16_t pos;     /* Row major position of the cursor */
+    screen_t screen;  /* The screen the cursor is moved to the position of */
+    
+    get_screen(&screen);
     
     /* Note: for now the cursor coords are just the screen coords */
-    cursor_x = screen_x;
-    cursor_y = screen_y;
+    cursor_x = *screen.x;
+    cursor_y = *screen.y;
     /* This will need revisiting when more cursor control is necessitated */
     
     /* Calculating the row major position of the cursor */
@@ -620,12 +694,6 @@ void update_cursor_active(void)
     outb((uint8_t) (pos & LAST_BYTE_MASK), VGA_CURSOR_DATA);
     outb(VGA_CURSOR_HIGH, VGA_CURSOR_CONTROL);
     outb((uint8_t) ((pos >> _BYTE) & LAST_BYTE_MASK), VGA_CURSOR_DATA);
-    
-    if (CURRENT_TASK.terminal->active)
-    {
-        screen_x = ACTIVE_TERMINAL.screen_x;
-        screen_y = ACTIVE_TERMINAL.screen_y;
-    }
 }
 
 
@@ -662,10 +730,13 @@ void update_cursor_mouse(void)
  * Return Value: None
  * Function: Clears the screen and sets the cursor to (0, 0) */
 void reset_screen(void){
+    screen_t screen;
+    
+    get_screen(&screen);
     clear();
-    screen_x = 0;
-    screen_y = 0;
-    //if (scheduling_started)
+    *screen.x = 0;
+    *screen.y = 0;
+    if (screen.shown)
     {
         update_cursor();
     }
@@ -687,21 +758,21 @@ void reset_screen_active(void){
  * Inputs: None
  * Return Value: None
  * Function: Scrolls all the display data up one line when we reach the bottom */
-static void scroll_display(void)
+static void scroll_display(screen_t* screen)
 {
     int32_t i;
     for (i = 0; i < NUM_ROWS - 1; i++)
     {
-        memcpy(video_mem + ((NUM_COLS * i) << 1), video_mem + ((NUM_COLS * (i + 1)) << 1), NUM_COLS << 1);
+        memcpy(screen->video_mem + ((NUM_COLS * i) << 1), screen->video_mem + ((NUM_COLS * (i + 1)) << 1), NUM_COLS << 1);
     }
     
     for (i = (NUM_ROWS - 1) * NUM_COLS; i < NUM_ROWS * NUM_COLS; i++)
     {
-        *(uint8_t *)(video_mem + (i << 1)) = BLANK_CHAR;
-        *(uint8_t *)(video_mem + (i << 1) + 1) = ATTRIB;
+        *(uint8_t *)(screen->video_mem + (i << 1)) = BLANK_CHAR;
+        *(uint8_t *)(screen->video_mem + (i << 1) + 1) = ATTRIB;
     }
     
-    screen_y--;
+    (*screen->y)--;
 }
 
 /* void scroll_display(void)
@@ -725,28 +796,3 @@ static void scroll_display_active(void)
     ACTIVE_TERMINAL.screen_y--;
 }
 
-/* void set_video_params(uint32_t x, uint32_t y)
- * Inputs: X and Y video location
- * Return Value: None
- * Function: Sets the global video variables based on params extracted from PCB
- */
-void set_video_params(uint32_t x, uint32_t y)
-{
-    screen_x = x;
-    screen_y = y;
-}
-
-/* void get_video_params(uint32_t x, uint32_t y)
- * Inputs: Pointer to stored x and y video location
- * Return Value: None
- * Function: Sets the PCB member variables to store the current video x and y
- */
-void get_video_params(uint32_t* x, uint32_t* y)
-{
-    if (x && y)
-    {
-        *x = screen_x;
-        *y = screen_y;
-    }
-}
-
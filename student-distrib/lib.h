@@ -10,6 +10,7 @@
 int32_t printf(int8_t *format, ...);
 void putc(uint8_t c);
 void putc_active(uint8_t c);
+void putn(const uint8_t* s, int32_t n);
 int32_t puts(int8_t *s);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
 int8_t *strrev(int8_t* s);
@@ -36,8 +37,6 @@ void update_cursor_active(void);
 void update_cursor_mouse(void);
 void reset_screen(void);
 void reset_screen_active(void);
-void set_video_params(uint32_t x, uint32_t y);
-void get_video_params(uint32_t* x, uint32_t* y);
 
 /* Port read functions */
 /* Inb reads a byte and returns its value as a zero-extended 32-bit
@@ -0,0 +1,225 @@
+#include "pipe_drivers.h"
+#include "lib.h"
+#include "slab.h"
+
+/* Cache the pipes come from */
+static kmem_cache_t pipe_cache = KMEM_CACHE("pipe", sizeof(pipe_t), 0);
+
+static void pipe_release(pipe_t* pipe, uint32_t flags);
+
+/* open_pipe
+ * Description: Allocate an empty pipe. The caller gets one reference to each end.
+ * Inputs: None
+ * Outputs: Returns a pointer to the pipe (stored as the inode of both fds), -1 if memory is full
+ */
+int32_t open_pipe(void){
+    pipe_t* pipe;
+    
+    if (!(pipe = kmem_cache_alloc(&pipe_cache)))
+    {
+        return -1;
+    }
+    
+    pipe->head = 0;
+    pipe->count = 0;
+    pipe->readers = 1;
+    pipe->writers = 1;
+    init_wait_queue(&(pipe->read_queue));
+    init_wait_queue(&(pipe->write_queue));
+    pipe->lock.locked = 0;
+    
+    return (int32_t)pipe;
+}
+
+/* read_pipe
+ * Description: Read whatever is in the pipe, up to nbytes. Sleeps while the pipe is
+ * empty and some fd can still write to it. The bytes are taken out a chunk at a
+ * time and copied to the user's buffer after the lock is dropped, so a fault on
+ * the buffer never happens while the lock is held.
+ * Inputs: fd: the read end; buf: where to put the bytes; nbytes: most bytes to read
+ * (sys_read has checked that the buffer is in user memory)
+ * Outputs: Returns the number of bytes read, or 0 at end of file (empty with no writers)
+ */
+int32_t read_pipe(int32_t fd, void* buf, int32_t nbytes){
+    pipe_t* pipe = (pipe_t*)CURRENT_PCB_ADDRESS->fd_array[fd].inode;
+    uint32_t flags; /* Variable for storing the flags */
+    uint8_t chunk[PIPE_CHUNK_SIZE]; /* Bytes taken out of the pipe but not copied yet */
+    int32_t count; /* Number of bytes in the chunk */
+    int32_t total = 0;
+    
+    do
+    {
+        spin_lock_irqsave(&(pipe->lock), flags);
+        
+        // Only the first chunk waits; after that, take whatever is there
+        while (!total && !pipe->count && pipe->writers)
+        {
+            sleep_on_locked(&(pipe->read_queue), &(pipe->lock));
+        }
+        
+        for (count = 0; (count < PIPE_CHUNK_SIZE) && (total + count < nbytes) && pipe->count; count++)
+        {
+            chunk[count] = pipe->buffer[pipe->head];
+            pipe->head = (pipe->head + 1) % PIPE_SIZE;
+            pipe->count--;
+        }
+        
+        // Room was made, so blocked writers can carry on
+        if (count)
+        {
+            wake_up(&(pipe->write_queue));
+        }
+        
+        spin_unlock_irqrestore(&(pipe->lock), flags);
+        
+        memcpy((uint8_t*)buf + total, chunk, count);
+        total += count;
+    } while ((count == PIPE_CHUNK_SIZE) && (total < nbytes));
+    
+    return total;
+}
+
+/* write_pipe
+ * Description: Write all nbytes to the pipe, sleeping whenever it fills up until a
+ * reader makes room. Gives up if every read end is closed. Each chunk is copied
+ * out of the user's buffer before the lock is taken.
+ * Inputs: fd: the write end; buf: the bytes; nbytes: number of bytes to write
+ * (sys_write has checked that the buffer is in user memory)
+ * Outputs: Returns nbytes, the number written before the last reader closed,
+ * or -1 if nothing could be written
+ */
+int32_t write_pipe(int32_t fd, const void* buf, int32_t nbytes){
+    pipe_t* pipe = (pipe_t*)CURRENT_PCB_ADDRESS->fd_array[fd].inode;
+    uint32_t flags; /* Variable for storing the flags */
+    uint8_t chunk[PIPE_CHUNK_SIZE]; /* Bytes copied from the user but not written yet */
+    int32_t count; /* Number of bytes in the chunk */
+    int32_t done;  /* Number of bytes of the chunk written */
+    int32_t i = 0;
+    
+    while (i < nbytes)
+    {
+        count = (nbytes - i < PIPE_CHUNK_SIZE) ? (nbytes - i) : PIPE_CHUNK_SIZE;
+        memcpy(chunk, (const uint8_t*)buf + i, count);
+        
+        spin_lock_irqsave(&(pipe->lock), flags);
+        
+        for (done = 0; done < count; )
+        {
+            while ((pipe->count == PIPE_SIZE) && pipe->readers)
+            {
+                sleep_on_locked(&(pipe->write_queue), &(pipe->lock));
+            }
+            if (!pipe->readers)
+            {
+                break;
+            }
+            
+            for (; (done < count) && (pipe->count < PIPE_SIZE); done++)
+            {
+                pipe->buffer[(pipe->head + pipe->count) % PIPE_SIZE] = chunk[done];
+                pipe->count++;
+            }
+            wake_up(&(pipe->read_queue));
+        }
+        
+        spin_unlock_irqrestore(&(pipe->lock), flags);
+        
+        i += done;
+        if (done < count)
+        {
+            break;
+        }
+    }
+    
+    return (i || !nbytes) ? i : -1;
+}
+
+/* close_pipe_reader
+ * Description: Drop a reference to the read end. Writers blocked on a full pipe
+ * are woken once nobody can read it, so they can give up.
+ * Inputs: fd: the read end
+ * Outputs: Returns 0
+ */
+int32_t close_pipe_reader(int32_t fd){
+    pipe_t* pipe = (pipe_t*)CURRENT_PCB_ADDRESS->fd_array[fd].inode;
+    uint32_t flags; /* Variable for storing the flags */
+    
+    spin_lock_irqsave(&(pipe->lock), flags);
+    if (!--pipe->readers)
+    {
+        wake_up(&(pipe->write_queue));
+    }
+    pipe_release(pipe, flags);
+    
+    return 0;
+}
+
+/* close_pipe_writer
+ * Description: Drop a reference to the write end. Readers blocked on an empty pipe
+ * are woken once nobody can write it, so they see end of file.
+ * Inputs: fd: the write end
+ * Outputs: Returns 0
+ */
+int32_t close_pipe_writer(int32_t fd){
+    pipe_t* pipe = (pipe_t*)CURRENT_PCB_ADDRESS->fd_array[fd].inode;
+    uint32_t flags; /* Variable for storing the flags */
+    
+    spin_lock_irqsave(&(pipe->lock), flags);
+    if (!--pipe->writers)
+    {
+        wake_up(&(pipe->read_queue));
+    }
+    pipe_release(pipe, flags);
+    
+    return 0;
+}
+
+/* dup_pipe_reader
+ * Description: Share the read end with another fd, which then reads the same pipe.
+ * Inputs: fd: the read end
+ * Outputs: Returns 0
+ */
+int32_t dup_pipe_reader(int32_t fd){
+    pipe_t* pipe = (pipe_t*)CURRENT_PCB_ADDRESS->fd_array[fd].inode;
+    uint32_t flags; /* Variable for storing the flags */
+    
+    spin_lock_irqsave(&(pipe->lock), flags);
+    pipe->readers++;
+    spin_unlock_irqrestore(&(pipe->lock), flags);
+    
+    return 0;
+}
+
+/* dup_pipe_writer
+ * Description: Share the write end with another fd, which then writes the same pipe.
+ * Inputs: fd: the write end
+ * Outputs: Returns 0
+ */
+int32_t dup_pipe_writer(int32_t fd){
+    pipe_t* pipe = (pipe_t*)CURRENT_PCB_ADDRESS->fd_array[fd].inode;
+    uint32_t flags; /* Variable for storing the flags */
+    
+    spin_lock_irqsave(&(pipe->lock), flags);
+    pipe->writers++;
+    spin_unlock_irqrestore(&(pipe->lock), flags);
+    
+    return 0;
+}
+
+/* pipe_release
+ * Description: Unlock a pipe after closing one of its ends, and free it if both
+ * ends are now closed. The pipe's lock must be held.
+ * Inputs: pipe: the pipe; flags: flags saved when the lock was taken
+ * Outputs: None
+ */
+static void pipe_release(pipe_t* pipe, uint32_t flags){
+    uint32_t unused = !pipe->readers && !pipe->writers;
+    
+    spin_unlock_irqrestore(&(pipe->lock), flags);
+    
+    // Nobody else has the pipe to take its lock, so it can go once unlocked
+    if (unused)
+    {
+        kmem_cache_free(&pipe_cache, pipe);
+    }
+}
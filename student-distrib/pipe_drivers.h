@@ -0,0 +1,43 @@
+#ifndef PIPE_DRIVERS_H
+#define PIPE_DRIVERS_H
+
+#include "types.h"
+#include "process.h"
+#include "wait_queue.h"
+
+/* Bytes a pipe can hold before writers block */
+#define PIPE_SIZE 0x1000
+
+/* Bytes copied to or from the user's buffer each time the pipe's lock is taken */
+#define PIPE_CHUNK_SIZE 0x80
+
+/* A pipe; a pointer to the struct is stored as the inode of both ends' fds */
+typedef struct pipe {
+    uint8_t buffer[PIPE_SIZE]; /* Ring buffer of bytes written but not read yet */
+    uint32_t head;             /* Index of the next byte to read */
+    uint32_t count;            /* Number of bytes in the buffer */
+    uint32_t readers;          /* Number of fds (across processes) for the read end */
+    uint32_t writers;          /* Number of fds (across processes) for the write end */
+    wait_queue_t read_queue;   /* Tasks blocked in read_pipe until there is data */
+    wait_queue_t write_queue;  /* Tasks blocked in write_pipe until there is room */
+    spinlock_t lock;           /* Lock protecting the buffer and counts */
+} pipe_t;
+
+/* Allocate an empty pipe with one reader and one writer; returns a pointer to it or -1. */
+extern int32_t open_pipe(void);
+
+/* Read from a pipe, blocking until there is data or no writers are left. */
+extern int32_t read_pipe(int32_t fd, void* buf, int32_t nbytes);
+
+/* Write to a pipe, blocking while it is full. */
+extern int32_t write_pipe(int32_t fd, const void* buf, int32_t nbytes);
+
+/* Close an end of a pipe, freeing the pipe once both ends are closed. */
+extern int32_t close_pipe_reader(int32_t fd);
+extern int32_t close_pipe_writer(int32_t fd);
+
+/* Share an end of a pipe with another fd (from dup2, fork or execute). */
+extern int32_t dup_pipe_reader(int32_t fd);
+extern int32_t dup_pipe_writer(int32_t fd);
+
+#endif
@@ -0,0 +1,109 @@
+/* process.c - Functions for allocating PIDs and kernel stacks
+ * vim:ts=4 noexpandtab
+ */
+
+#include "process.h"
+#include "slab.h"
+#include "shm.h"
+#include "spinlock.h"
+#include "lib.h"
+
+pcb_t* pid_table[MAX_PIDS];
+
+/* Stack of the PIDs that aren't in use */
+static uint32_t free_pids[MAX_PIDS];
+static uint32_t num_free_pids = 0;
+
+/* Each PCB sits at the bottom of its 8KB kernel stack, so the cache hands out both */
+static kmem_cache_t pcb_cache = KMEM_CACHE("pcb", EIGHT_K, EIGHT_K);
+
+/* Lock protecting the PID table and the free PIDs */
+spinlock_t process_lock = SPINLOCK_UNLOCKED;
+
+/*
+ * process_init
+ *   DESCRIPTION: Marks every PID as free. PID 0 is handed out first.
+ *   INPUTS: None
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void process_init(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < MAX_PIDS; i++)
+    {
+        pid_table[i] = NULL;
+        free_pids[i] = MAX_PIDS - 1 - i;
+    }
+    num_free_pids = MAX_PIDS;
+}
+
+/*
+ * process_alloc
+ *   DESCRIPTION: Pops a free PID and gives it an 8KB kernel stack from the
+ *                PCB cache (aligned to its size, as the PCB lookup from ESP
+ *                needs). The process has no user pages until vm_exec.
+ *   INPUTS: None
+ *   OUTPUTS: None
+ *   RETURN VALUE: The new process's PCB with pid filled in, or NULL if there
+ *                 are no PIDs or memory left
+ *   SIDE EFFECTS: None
+ */
+pcb_t* process_alloc(void)
+{
+    /* Local variables */
+    pcb_t* pcb;     /* PCB of the new process */
+    uint32_t pid;   /* PID of the new process */
+    uint32_t flags; /* Save variable for flags */
+
+    spin_lock_irqsave(&process_lock, flags);
+
+    if (!num_free_pids)
+    {
+        spin_unlock_irqrestore(&process_lock, flags);
+        return NULL;
+    }
+    pid = free_pids[--num_free_pids];
+
+    if (!(pid_table[pid] = kmem_cache_alloc(&pcb_cache)))
+    {
+        free_pids[num_free_pids++] = pid;
+        spin_unlock_irqrestore(&process_lock, flags);
+        return NULL;
+    }
+    pcb = pid_table[pid];
+
+    spin_unlock_irqrestore(&process_lock, flags);
+
+    pcb->pid = pid;
+    memset(pcb->page_tables, 0, sizeof(pcb->page_tables));
+    pcb->num_vm_areas = 0;
+    pcb->template = NULL;
+    return pcb;
+}
+
+/*
+ * process_free
+ *   DESCRIPTION: Frees the PID, kernel stack and user pages of a process,
+ *                along with any shared memory it created that was never mapped.
+ *   INPUTS: pcb: The process going away, whose pages must not be mapped in and
+ *                whose kernel stack must not be in use (see schedule_finish)
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void process_free(pcb_t* pcb)
+{
+    uint32_t flags;
+
+    vm_release(pcb);
+    shm_exit(pcb);
+
+    spin_lock_irqsave(&process_lock, flags);
+    pid_table[pcb->pid] = NULL;
+    free_pids[num_free_pids++] = pcb->pid;
+    kmem_cache_free(&pcb_cache, pcb);
+    spin_unlock_irqrestore(&process_lock, flags);
+}
@@ -4,6 +4,9 @@
 #define _PROCESS_H
 
 #include "terminal.h"
+#include "cpu.h"
+#include "vm.h"
+#include "spinlock.h"
 
 /* Constants relating to commmon memory block sizes */
 #define ONE_K 0x400
@@ -13,10 +16,8 @@
 #define EIGHT_K (0x08 * ONE_K)
 #define EIGHT_M (0x08 * ONE_M)
 
-/* Constants for commonly used memory addresses */
+/* Constants for commonly used memory addresses (the user window is in vm.h) */
 #define VIDMEM 0xB8000
-#define VIRTUAL_BEGIN (ONE_M * 128)
-#define VIRTUAL_END (ONE_M * 132)
 
 /* Bitmask to wipe off the lower 13 bits to isolate the top of the kernel stack */
 #define KERNEL_STACK_MASK 0xFFFFE000
@@ -32,28 +33,48 @@
 #define FOPS_READ  0x01
 #define FOPS_WRITE 0x02
 #define FOPS_CLOSE 0x03
+#define FOPS_DUP   0x04
+#define FOPS_READV  0x05
+#define FOPS_WRITEV 0x06
+#define FOPS_LSEEK  0x07
+#define FOPS_PREAD  0x08
+
+/* Where lseek measures its offset from */
+#define SEEK_SET 0x00 /* The start of the file */
+#define SEEK_CUR 0x01 /* The current position */
+#define SEEK_END 0x02 /* The end of the file */
+
+/* Furthest position lseek can move a file to (the largest position it can return) */
+#define MAX_FILE_POSITION 0x7FFFFFFF
+
+/* Most buffers one readv or writev can take, and most bytes they can add up to */
+#define MAX_IOV 0x10
+#define MAX_IOV_BYTES 0x7FFFFFFF
 
 /* The first file descriptor is at 2 because stdin/out occupy slots 0 and 1 */
 #define FIRST_FD 2
 
-/* Constant used for calculating page offsets */
-#define PID_OFFSET 2
+/* Size of the FXSAVE area for a process's FPU/SSE registers */
+#define FPU_STATE_SIZE 0x200
 
-/* Macro for calculating the bottom of the kernel stack for a given process number */
-#define KERNEL_STACK_ADDRESS(process_number) (EIGHT_M - process_number * EIGHT_K - 0x04)
+/* Most PIDs there can be (the size of the PID table) */
+#define MAX_PIDS 0x400
 
-/* Macro which calculates the pointer of the PCB for a given process number */
-#define PCB_ADDRESS(number) ((pcb_t*) (KERNEL_STACK_ADDRESS(number) & KERNEL_STACK_MASK))
+/* PID of the idle tasks, which run on the boot stacks (the bootstrap processor's is the 8KB below 8MB) */
+#define IDLE_PID 0xFFFFFFFF
+#define BOOT_STACK_PCB ((pcb_t*) (EIGHT_M - EIGHT_K))
 
-/* Macro which returns the pointer to the current PCB */
-#define CURRENT_PCB_ADDRESS (PCB_ADDRESS(global_pid))
+/* Macro which returns the pointer of the PCB for a given process number (the idle task's is this processor's) */
+#define PCB_ADDRESS(number) (((number) == IDLE_PID) ? CURRENT_CPU->idle : pid_table[(number)])
 
-/* The total number of processes that can be run */
-#define NUM_PROCESSES 0x06
+/* Macro for calculating the bottom of the kernel stack for a given process number */
+#define KERNEL_STACK_ADDRESS(number) ((uint32_t) PCB_ADDRESS(number) + EIGHT_K - 0x04)
+
+/* Macro which returns the pointer to the current PCB */
+#define CURRENT_PCB_ADDRESS (PCB_ADDRESS(CURRENT_PID))
 
-/* Flags for determining whether or not PID's are available */
+/* Flags for determining whether or not an FD is available */
 #define AVAILABLE   0x00000000
-#define UNAVAILABLE 0xFFFFFFFF
 
 /* Maximum size of the args that can be gotten from the command line (128) */
 #define MAX_ARG_SIZE 0x80
@@ -61,32 +82,26 @@
 /* User priviledge level value */
 #define USER_PRIV 3
 
-/* Macro to get the first available PID */
-#define FIRST_AVAILABLE_PID(number) do {            \
-        number = 0;                                 \
-        while(pid_availability[number])             \
-        {                                           \
-            number++;                               \
-            if (number > NUM_PROCESSES)             \
-            {                                       \
-                number = UNAVAILABLE;               \
-                break;                              \
-            }                                       \
-        }                                           \
-        if (number != UNAVAILABLE)                  \
-        {                                           \
-            pid_availability[number] = UNAVAILABLE; \
-        }                                           \
-    } while (0)
-
-/* Macro for marking the passed in PID as being available */
-#define REMOVE_PID(number) do { pid_availability[number] = AVAILABLE; } while (0)
-
 /* Generic function pointers for use in the file_ops in the file descriptor */
 typedef int32_t (*open_t)(const uint8_t * filename);
 typedef int32_t (*read_t)(int32_t fd, void* buf, int32_t nbytes);
 typedef int32_t (*write_t)(int32_t fd, const void* buf, int32_t nbytes);
 typedef int32_t (*close_t)(int32_t fd);
+typedef int32_t (*dup_t)(int32_t fd);
+
+/* One of the buffers of a readv or writev */
+typedef struct iovec {
+    void* base;  /* Start of the buffer */
+    int32_t len; /* Bytes in the buffer */
+} iovec_t;
+
+/* Optional vectored operations; the iovecs have been checked and copied into the kernel */
+typedef int32_t (*readv_t)(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+typedef int32_t (*writev_t)(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+
+/* Optional positional operations, for files that can be read at any offset */
+typedef int32_t (*lseek_t)(int32_t fd, int32_t offset, int32_t whence);
+typedef int32_t (*pread_t)(int32_t fd, void* buf, int32_t nbytes, int32_t offset);
 
 /* A struct used for the file descriptor array */
 typedef struct fd_entry {
@@ -124,26 +139,80 @@ typedef struct pcb pcb_t;
     /* ESP0 of the current process for when the scheduler interrupts; used in the schedule function */
     uint32_t schedule_esp0;
     
-    /* The number of the terminal that the process is currently executing on */
-    uint32_t terminal_number;
+    /* PID of this process */
+    uint32_t pid;
+    
+    /* Flag for processes made by sys_fork, which have no parent waiting in sys_execute */
+    uint32_t forked;
+    
+    /* Page tables of the user window from VIRTUAL_BEGIN, one per 4MB (NULL where nothing is mapped) */
+    uint32_t* page_tables[USER_TABLES];
+    
+    /* Areas of the user window, whose pages are filled in when first touched */
+    vm_area_t vm_areas[MAX_VM_AREAS];
+    uint32_t num_vm_areas;
     
-    /* Frequency that the RTC is programmed to; used in virtualization of the RTC */
-    uint32_t rtc_freq;
+    /* Template of the executable the process runs, which is kept while it runs */
+    exec_template_t* template;
     
-    /* Flag for signaling that an RTC interrupt has occured */
-    uint32_t rtc_interrupt_occurred;
+    /* Current end of the heap, moved by sys_sbrk */
+    uint32_t brk;
+    
+    /* Most bytes the stack and heap can grow to; set with sys_setlimit and inherited by children */
+    uint32_t stack_limit;
+    uint32_t heap_limit;
+    
+    /* Index of the processor whose run queue the process goes on */
+    uint32_t cpu;
+    
+    /* Whether the process is runnable or blocked on a wait queue */
+    uint32_t state;
+    
+    /* Current level in the scheduler's feedback queue (0 is the highest priority) */
+    uint32_t priority;
+    
+    /* Highest level the process can be promoted to; set with sys_nice */
+    uint32_t base_priority;
+    
+    /* Number of PIT ticks used out of the current quantum */
+    uint32_t ticks_used;
+    
+    /* Next process on the run queue */
+    pcb_t* run_next;
+    
+    /* Next process sleeping on the same wait queue */
+    pcb_t* wait_next;
+    
+    /* The number of the terminal that the process is currently executing on */
+    uint32_t terminal_number;
     
     /* Pointer to the terminal struct that the current process is executing on */
     terminal_t* terminal;
     
     /* Array for holding the command line args; used in sys_getargs */
     uint8_t args[MAX_ARG_SIZE];
+    
+    /* Flag for whether the process has used the FPU (and so has state to restore) */
+    uint32_t fpu_used;
+    
+    /* FPU/SSE registers saved while another process uses the FPU; FXSAVE needs 16 byte alignment */
+    uint8_t fpu_state[FPU_STATE_SIZE] __attribute__((aligned(16)));
 };
 
-/* PID of the process that is currently running; used in calculating PCB address */
-uint32_t global_pid;
+/* PCB of every PID in use (NULL for free PIDs); a PID's kernel stack goes back
+ * to the PCB cache when it's freed */
+extern pcb_t* pid_table[MAX_PIDS];
+
+/* Lock protecting the PID table, for walking it */
+extern spinlock_t process_lock;
+
+/* Set up the PID allocator */
+extern void process_init(void);
+
+/* Allocate a PID and kernel stack for a new process; returns its PCB or NULL */
+extern pcb_t* process_alloc(void);
 
-/* Array containing flags for whether or not a given PID is available */
-uint32_t pid_availability[NUM_PROCESSES];
+/* Free the PID, kernel stack and user pages of a process that is going away */
+extern void process_free(pcb_t* pcb);
 
 #endif /* _PROCESS_H */
@@ -6,6 +6,7 @@
 #define _RTC_H
 
 #include "types.h"
+#include "spinlock.h"
 
 /* Port number for the RTC */
 #define RTC_PORT 0x70
@@ -26,6 +27,9 @@ void rtc_init(void);
 /* Function for RTC interrupts */
 void rtc_interrupt(void);
 
+/* Lock protecting the RTC's registers and the virtual RTCs */
+extern spinlock_t rtc_lock;
+
 extern int rtc_interrupt_counter;
 extern int rtc_interrupt_occurred;
 
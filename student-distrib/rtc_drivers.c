@@ -0,0 +1,336 @@
+#include "tests.h"
+#include "x86_desc.h"
+#include "lib.h"
+#include "handlers.h"
+#include "keyboard.h"
+#include "rtc_drivers.h"
+#include "rtc.h"
+#include "process.h"
+#include "scheduling.h"
+#include "i8259.h"
+#include "slab.h"
+
+#define STDERR 2
+#define REGISTER_A_MASK 0xF0
+#define BYTES_READ 4
+
+#define RATE_MAX 6
+#define _2_HZ 2
+#define _4_HZ 4
+#define _8_HZ 8
+#define _16_HZ 16
+#define _32_HZ 32
+#define _64_HZ 64
+#define _128_HZ 128
+#define _256_HZ 256
+#define _512_HZ 512
+
+#define RTC_RATE_MASK 0x0F
+
+// Global variables for use with virtualizing the RTC 
+
+int rtc_virtual_interrupt_counter = 0;
+
+/* Cache the virtual RTCs of open files come from */
+static kmem_cache_t rtc_file_cache = KMEM_CACHE("rtc_file", sizeof(rtc_file_t), 0);
+
+/* Number of open files at each frequency, indexed by log2 of the frequency */
+static uint32_t files_at_frequency[MAX_HZ_LOG2 + 1];
+
+/* Open files with sleeping readers, sorted by soonest deadline first */
+static rtc_file_t* deadline_queue = NULL;
+
+/* Virtual time in 1024 Hz ticks, and how far one hardware interrupt advances it */
+static uint32_t rtc_time = 0;
+static uint32_t rtc_step = 1;
+
+/* Frequency the hardware is currently programmed to (0 when the IRQ is off) */
+static uint32_t hardware_frequency = 0;
+
+static void rtc_update_rate(void);
+static void deadline_insert(rtc_file_t* file);
+static void deadline_remove(rtc_file_t* file);
+static uint32_t frequency_index(uint32_t frequency);
+
+/* open_rtc
+ * Description: Allocate a virtual RTC for the file, initially at 2 Hz, and make sure
+ * the hardware is interrupting fast enough for it.
+ * Inputs: Unused params for consistency with system call params.
+ * Outputs: Returns a pointer to the virtual RTC (stored as the fd's inode), -1 if memory is full
+ */
+int32_t open_rtc(const uint8_t* filename){
+    uint32_t flags; /* Variable for storing the flags */
+    rtc_file_t* file;
+    
+    if (!(file = kmem_cache_alloc(&rtc_file_cache)))
+    {
+        return -1;
+    }
+    
+    file->frequency = INITIAL_FREQUENCY;
+    file->period = MAX_HZ / INITIAL_FREQUENCY;
+    file->queued = FALSE;
+    file->refs = 1;
+    file->next = NULL;
+    init_wait_queue(&(file->readers));
+    
+    spin_lock_irqsave(&rtc_lock, flags);
+    
+    files_at_frequency[frequency_index(INITIAL_FREQUENCY)]++;
+    rtc_update_rate();
+    
+    spin_unlock_irqrestore(&rtc_lock, flags);
+    return (int32_t)file;
+}
+
+
+/* read_rtc
+ * Description: Return after the file's next virtual interrupt. The file is put on the
+ * deadline queue and the caller sleeps until rtc_virtual_tick reaches its deadline.
+ * Inputs: fd: the RTC file descriptor; buf and nbytes unused.
+ * Outputs: Returns 0 only after an interrupt has occurred.
+ */
+int32_t read_rtc(int32_t fd, void* buf, int32_t nbytes){
+    rtc_file_t* file = (rtc_file_t*)CURRENT_PCB_ADDRESS->fd_array[fd].inode;
+    uint32_t flags; /* Variable for storing the flags */
+    
+    spin_lock_irqsave(&rtc_lock, flags);
+    
+    // Virtual interrupts happen on multiples of the period, like the old 1024 Hz counter
+    if (!file->queued)
+    {
+        file->deadline = rtc_time - (rtc_time % file->period) + file->period;
+        deadline_insert(file);
+    }
+    
+    /* Sleeping until the deadline has passed */
+    while (file->queued)
+    {
+        sleep_on_locked(&(file->readers), &rtc_lock);
+    }
+    
+    spin_unlock_irqrestore(&rtc_lock, flags);
+    
+    return 0;
+}
+
+
+/* write_rtc
+ * Description: Sets the psuedo-interrupt frequency of the virtualized RTC.
+ * ONLY accepts powers of 2 between 2Hz and 1024 Hz.
+ * Inputs: const void* buf: the target frequency
+ * fd and nbytes: Unused params for consistency with system call params.
+ * Outputs: Returns 0 on success, -1 on invalid frequency 
+ */
+int32_t write_rtc(int32_t fd, const void* buf, int32_t nbytes){
+    int user_rate = *(int*)buf;
+    if (user_rate > MAX_HZ || user_rate <= 0) {
+        return -1;
+    }
+    // Valid frequencies are 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024. Faster than a case statement or algorithm.
+    if (!(user_rate == _2_HZ || user_rate == _4_HZ  || user_rate == _8_HZ  || user_rate == _16_HZ  
+    || user_rate == _32_HZ  || user_rate == _64_HZ  || user_rate == _128_HZ  || user_rate == _256_HZ  || user_rate == _512_HZ  || user_rate == MAX_HZ)){
+        return -1;
+    }
+     
+    uint32_t flags; /* Variable for storing the flags */
+    spin_lock_irqsave(&rtc_lock, flags);
+
+    // Store this file's RTC frequency and reprogram the hardware if it needs to speed up or slow down
+    rtc_file_t* file = (rtc_file_t*)CURRENT_PCB_ADDRESS->fd_array[fd].inode;
+    files_at_frequency[frequency_index(file->frequency)]--;
+    files_at_frequency[frequency_index(user_rate)]++;
+    file->frequency = user_rate;
+    file->period = MAX_HZ / user_rate;
+    rtc_update_rate();
+
+    spin_unlock_irqrestore(&rtc_lock, flags);
+
+    return BYTES_READ;
+
+}
+
+/* close_rtc
+ * Description: Close the RTC. Once no fd uses the file's virtual RTC, releases it and
+ * turns the hardware down (or off) if it was the fastest opener.
+ * Inputs: fd: the RTC file descriptor
+ * Outputs: Returns 0
+ */
+int32_t close_rtc(int32_t fd){
+    rtc_file_t* file = (rtc_file_t*)CURRENT_PCB_ADDRESS->fd_array[fd].inode;
+    uint32_t flags; /* Variable for storing the flags */
+    
+    spin_lock_irqsave(&rtc_lock, flags);
+    
+    if (--(file->refs))
+    {
+        spin_unlock_irqrestore(&rtc_lock, flags);
+        return 0;
+    }
+    
+    if (file->queued)
+    {
+        deadline_remove(file);
+        wake_up(&(file->readers));
+    }
+    files_at_frequency[frequency_index(file->frequency)]--;
+    rtc_update_rate();
+    
+    spin_unlock_irqrestore(&rtc_lock, flags);
+    
+    kmem_cache_free(&rtc_file_cache, file);
+    
+    return 0;
+}
+
+/* dup_rtc
+ * Description: Shares an fd's virtual RTC with a forked child, whose copy of the fd
+ * then reads and sets the same file.
+ * Inputs: fd: the RTC file descriptor
+ * Outputs: Returns 0
+ */
+int32_t dup_rtc(int32_t fd){
+    rtc_file_t* file = (rtc_file_t*)CURRENT_PCB_ADDRESS->fd_array[fd].inode;
+    uint32_t flags; /* Variable for storing the flags */
+    
+    spin_lock_irqsave(&rtc_lock, flags);
+    file->refs++;
+    spin_unlock_irqrestore(&rtc_lock, flags);
+    
+    return 0;
+}
+
+/* rtc_virtual_tick
+ * Description: Called on every hardware RTC interrupt. Advances virtual time and wakes
+ * the readers of every file whose deadline has passed. Only the front of the queue is
+ * looked at, so a tick with nothing expiring is O(1). rtc_lock must be held.
+ * Inputs: None
+ * Outputs: None
+ */
+void rtc_virtual_tick(void){
+    rtc_file_t* file;
+    
+    rtc_time += rtc_step;
+    
+    while (deadline_queue && (int32_t)(rtc_time - deadline_queue->deadline) >= 0)
+    {
+        file = deadline_queue;
+        deadline_queue = file->next;
+        file->next = NULL;
+        file->queued = FALSE;
+        wake_up(&(file->readers));
+    }
+}
+
+/* rtc_update_rate
+ * Description: Programs the RTC to the lowest rate that covers every open file (the
+ * highest requested frequency, since they're all powers of 2), or masks the IRQ
+ * when there are no open files. rtc_lock must be held.
+ * Inputs: None
+ * Outputs: None
+ */
+static void rtc_update_rate(void){
+    uint32_t frequency = 0;
+    uint32_t rate;
+    uint32_t i;
+    
+    for (i = MAX_HZ_LOG2; i > 0; i--)
+    {
+        if (files_at_frequency[i])
+        {
+            frequency = 1 << i;
+            break;
+        }
+    }
+    
+    if (frequency == hardware_frequency)
+    {
+        return;
+    }
+    
+    if (!frequency)
+    {
+        disable_irq(RTC_IRQ);
+        hardware_frequency = 0;
+        return;
+    }
+    
+    // Rate 6 is 1024 Hz and every step up halves the frequency
+    rate = RATE_MAX;
+    for (i = MAX_HZ; i > frequency; i >>= 1)
+    {
+        rate++;
+    }
+    
+    //flip all params given by OSdev
+    outb(RTC_REGISTER_A, RTC_PORT);        // set index to register A, disable NMI
+    char prev=inb(RTC_PORT + 1);    // get initial value of register A
+    outb(RTC_REGISTER_A, RTC_PORT);        // reset index to A
+    outb(((prev & REGISTER_A_MASK) | (rate & RTC_RATE_MASK)), RTC_PORT + 1); //write only our rate to A. Note, rate is the bottom 4 bits.
+    
+    rtc_step = MAX_HZ / frequency;
+    
+    if (!hardware_frequency)
+    {
+        enable_irq(RTC_IRQ);
+    }
+    hardware_frequency = frequency;
+}
+
+/* deadline_insert
+ * Description: Adds the file to the deadline queue, keeping it sorted by deadline.
+ * rtc_lock must be held.
+ * Inputs: file: the file to add, with its deadline already set
+ * Outputs: None
+ */
+static void deadline_insert(rtc_file_t* file){
+    rtc_file_t** link = &deadline_queue;
+    
+    while (*link && (int32_t)((*link)->deadline - file->deadline) <= 0)
+    {
+        link = &((*link)->next);
+    }
+    
+    file->next = *link;
+    *link = file;
+    file->queued = TRUE;
+}
+
+/* deadline_remove
+ * Description: Takes the file off of the deadline queue.
+ * rtc_lock must be held.
+ * Inputs: file: the file to remove
+ * Outputs: None
+ */
+static void deadline_remove(rtc_file_t* file){
+    rtc_file_t** link = &deadline_queue;
+    
+    while (*link && *link != file)
+    {
+        link = &((*link)->next);
+    }
+    
+    if (*link)
+    {
+        *link = file->next;
+    }
+    
+    file->next = NULL;
+    file->queued = FALSE;
+}
+
+/* frequency_index
+ * Description: Finds where a frequency is counted in files_at_frequency.
+ * Inputs: frequency: a power of 2 up to MAX_HZ
+ * Outputs: Returns log2 of the frequency
+ */
+static uint32_t frequency_index(uint32_t frequency){
+    uint32_t index = 0;
+    
+    while (frequency >>= 1)
+    {
+        index++;
+    }
+    
+    return index;
+}
@@ -0,0 +1,45 @@
+#ifndef RTC_DRIVERS_H
+#define RTC_DRIVERS_H
+
+#include "types.h"
+#include "process.h"
+#include "wait_queue.h"
+
+#define MAX_HZ 1024
+#define INITIAL_FREQUENCY 2
+
+/* log2 of MAX_HZ; virtual frequencies are counted by their log2 */
+#define MAX_HZ_LOG2 10
+
+/* State of one open RTC file; a pointer to the struct is stored as the fd's inode */
+typedef struct rtc_file {
+    uint32_t frequency;       /* Virtual frequency the file is programmed to */
+    uint32_t period;          /* Number of 1024 Hz ticks between virtual interrupts */
+    uint32_t deadline;        /* Tick at which the sleeping readers should be woken */
+    uint32_t queued;          /* Flag for whether the file is on the deadline queue */
+    uint32_t refs;            /* Number of fds (across forked processes) using the file */
+    struct rtc_file* next;    /* Next file on the deadline queue (sorted by deadline) */
+    wait_queue_t readers;     /* Tasks blocked in read_rtc on this file */
+} rtc_file_t;
+
+extern int32_t rtc_virtual_interrupt_counter;
+
+/* Allocate a virtual RTC at 2Hz; returns a pointer to it or -1. */
+extern int32_t open_rtc(const uint8_t* filename);
+
+/* Return after an RTC interrupt has occurred. */
+extern int32_t read_rtc(int32_t fd, void* buf, int32_t nbytes);
+
+/* Set the interrupt frequency of the RTC. */
+extern int32_t write_rtc(int32_t fd, const void* buf, int32_t nbytes);
+
+/* Close the RTC and release its virtual RTC once no fd uses it. */
+extern int32_t close_rtc(int32_t fd);
+
+/* Share an fd's virtual RTC with a forked child. */
+extern int32_t dup_rtc(int32_t fd);
+
+/* Advance virtual time by one hardware tick and wake any expired readers. */
+extern void rtc_virtual_tick(void);
+
+#endif
@@ -13,39 +13,82 @@
 #include "paging.h"
 #include "i8259.h"
 #include "modex.h"
-#include "jank_malloc.h"
+#include "fpu.h"
+#include "cpu.h"
+#include "apic.h"
+#include "handlers.h"
+#include "clock.h"
 
 // Global vars for use with handlers, shell startup, virtualization, etc.
  int pit_interrupt_counter = 0;
- int pcb_all_started = 0;
  int scheduler_started = 0;
 
+/* Lock protecting the run queues, the state of every process and the wait queues */
+spinlock_t sched_lock = SPINLOCK_UNLOCKED;
+
+/* Run queues of processes waiting for each processor (running processes aren't on them) */
+static run_queue_t run_queues[MAX_CPUS];
+
+/* Bitmask of the terminals waiting for the idle task to start a base shell on them */
+static uint32_t shells_wanted = 0;
+
+/* Value of the PIT counter when priorities were last boosted */
+static int last_boost = 0;
+
+static void run_queue_add(pcb_t* pcb);
+static pcb_t* run_queue_pop(run_queue_t* queue);
+static uint32_t highest_waiting_priority(run_queue_t* queue);
+static void boost_priorities(void);
+static void update_tick(pcb_t* running);
+static void notify_cpu(uint32_t cpu);
+static uint32_t shells_wanted_here(void);
+static void idle_task(void);
+
 /* start_scheduler
- * Description: Allows scheduler to begin by initializing the task structs
- * and initializiating the PIT and executing the first shell.
+ * Description: Allows scheduler to begin by setting up the idle task and the
+ * run queue and initializiating the PIT. The boot context then becomes the
+ * idle task, which starts the shells on its first call to schedule.
  * Inputs: None
  * Outputs: None
  */
 void start_scheduler(void)
 {
     /* Local variables */
-    uint32_t i; /* Iteration variable */
+    pcb_t* idle; /* Pointer to the idle task's PCB */
+    uint32_t i;  /* Iteration variables */
+    uint32_t j;
     
     /* Clear interrupts */
     cli();
     
-    /* Initializing the task structures */
-    for (i = 0; i < NUM_TASKS; i++)
+    /* The idle task's PCB is at the bottom of the boot stack we are running on,
+     * far below anything the boot code has pushed */
+    idle = IDLE_PCB;
+    memset(idle, 0, sizeof(pcb_t));
+    idle->pid = IDLE_PID;
+    idle->state = TASK_RUNNABLE;
+    idle->terminal = NULL;
+    idle->cpu = CURRENT_CPU->id;
+    
+    /* Mark that the idle task is the one running */
+    CURRENT_PID = IDLE_PID;
+    for (i = 0; i < MAX_CPUS; i++)
     {
-        tasks[i].started = !i; /* Evaluates to false for all values but 0 */
-        tasks[i].terminal = &(terminals[i]);
+        for (j = 0; j < NUM_PRIORITIES; j++)
+        {
+            run_queues[i].head[j] = NULL;
+            run_queues[i].tail[j] = NULL;
+        }
     }
-    
-    /* Mark that the starting task is 0 */
-    current_task = 0;
+    shells_wanted = (1 << NUM_TERMINALS) - 1;
+    last_boost = pit_interrupt_counter;
 
-    /* Initialize the PIT */
+    /* Initialize the PIT, ticking from the start if the time page needs it */
     init_pit();
+    if (clock_needs_tick())
+    {
+        pit_arm_tick();
+    }
 
     set_mode_X();
 
@@ -57,104 +100,670 @@ void start_scheduler(void)
 
     terminal_open(0);
 
-    // test_malloc();
-    // test_free();
     
     /* Indicate that the scheduler has started */
     scheduling_started = TRUE;
  
-     /* Execute the first shell */
-    sys_execute((uint8_t*)"shell");
-    sti();
+    /* Become the idle task; never returns */
+    idle_task();
+}
+
+/*
+ * start_scheduler_ap
+ *      SUMMARY: Turns the boot context of an application processor into its
+ *       idle task, which waits for the bootstrap processor to finish starting
+ *       the scheduler before taking processes from its run queue
+ *       INPUTS: none
+ *      OUTPUTS: none
+ * SIDE EFFECTS: Never returns
+ */
+void start_scheduler_ap(void)
+{
+    /* Local variables */
+    pcb_t* idle; /* Pointer to the idle task's PCB */
+    
+    cli();
+    
+    idle = IDLE_PCB;
+    memset(idle, 0, sizeof(pcb_t));
+    idle->pid = IDLE_PID;
+    idle->state = TASK_RUNNABLE;
+    idle->terminal = NULL;
+    idle->cpu = CURRENT_CPU->id;
+    CURRENT_PID = IDLE_PID;
+    
+    while (!scheduling_started)
+    {
+        asm volatile ("pause" : : : "memory");
+    }
+    
+    idle_task();
+}
+
+/*
+ * idle_task
+ *      SUMMARY: Body of the idle task. Hands the processor to the run queue
+ *       whenever something is runnable and halts until the next interrupt otherwise.
+ *       INPUTS: none
+ *      OUTPUTS: none
+ * SIDE EFFECTS: Never returns
+ */
+static void idle_task(void)
+{
+    while (1)
+    {
+        cli();
+        spin_lock(&sched_lock);
+        
+        /* Hand over the processor while there is work, checking again once we are switched back to */
+        if ((highest_waiting_priority(CURRENT_RUN_QUEUE) < NUM_PRIORITIES) || shells_wanted_here())
+        {
+            schedule_locked();
+            spin_unlock(&sched_lock);
+            continue;
+        }
+        
+        spin_unlock(&sched_lock);
+        
+        /* sti only takes effect after the next instruction, so a wakeup can't
+         * slip in between the check above and the hlt */
+        asm volatile ("   \n\
+                sti       \n\
+                hlt       \n\
+                "
+                :
+                :
+                : "memory", "cc"
+        );
+    }
+}
+
+/*
+ * run_queue_add
+ *      SUMMARY: Adds a runnable process to the back of the queue for its
+ *       priority on the processor it last ran on
+ *       INPUTS: pcb -- the process to add
+ *      OUTPUTS: none
+ * SIDE EFFECTS: sched_lock must be held
+ */
+static void run_queue_add(pcb_t* pcb)
+{
+    /* Local variables */
+    run_queue_t* queue = &(run_queues[pcb->cpu]); /* The queue to add to */
+    
+    pcb->run_next = NULL;
+    
+    if (queue->tail[pcb->priority])
+    {
+        queue->tail[pcb->priority]->run_next = pcb;
+    }
+    else
+    {
+        queue->head[pcb->priority] = pcb;
+    }
+    queue->tail[pcb->priority] = pcb;
+}
+
+/*
+ * run_queue_pop
+ *      SUMMARY: Removes the process at the front of the highest priority level of a run queue
+ *       INPUTS: queue -- the run queue to take the process from
+ *      OUTPUTS: none
+ * RETURN VALUE: The removed process, or NULL if every level is empty
+ * SIDE EFFECTS: sched_lock must be held
+ */
+static pcb_t* run_queue_pop(run_queue_t* queue)
+{
+    /* Local variables */
+    uint32_t priority = highest_waiting_priority(queue); /* Level to take the process from */
+    pcb_t* pcb;                                          /* The process at the front of the level */
+    
+    if (priority == NUM_PRIORITIES)
+    {
+        return NULL;
+    }
+    
+    pcb = queue->head[priority];
+    queue->head[priority] = pcb->run_next;
+    if (!queue->head[priority])
+    {
+        queue->tail[priority] = NULL;
+    }
+    pcb->run_next = NULL;
+    
+    return pcb;
+}
+
+/*
+ * highest_waiting_priority
+ *      SUMMARY: Finds the highest priority level of a run queue that has a process waiting on it
+ *       INPUTS: queue -- the run queue to look at
+ *      OUTPUTS: none
+ * RETURN VALUE: The level, or NUM_PRIORITIES if no process is waiting
+ */
+static uint32_t highest_waiting_priority(run_queue_t* queue)
+{
+    /* Local variables */
+    uint32_t i; /* Iteration variable */
+    
+    for (i = 0; i < NUM_PRIORITIES; i++)
+    {
+        if (queue->head[i])
+        {
+            break;
+        }
+    }
+    
+    return i;
+}
+
+/*
+ * boost_priorities
+ *      SUMMARY: Moves every process back to its base priority so that processes
+ *       which were demoted for using the processor don't starve
+ *       INPUTS: none
+ *      OUTPUTS: none
+ * SIDE EFFECTS: sched_lock must be held
+ */
+static void boost_priorities(void)
+{
+    /* Local variables */
+    pcb_t* waiting = NULL; /* Processes taken off the run queues, in the order they'd have run */
+    pcb_t* last = NULL;    /* Last process on the above list */
+    pcb_t* pcb;            /* Iteration variable for the processes */
+    uint32_t i;            /* Iteration variable */
+    
+    /* Take everything off the run queues without losing its place in line */
+    for (i = 0; i < num_cpus; i++)
+    {
+        while ((pcb = run_queue_pop(&(run_queues[i]))))
+        {
+            if (last)
+            {
+                last->run_next = pcb;
+            }
+            else
+            {
+                waiting = pcb;
+            }
+            last = pcb;
+        }
+    }
+    
+    /* Reset every process (running, waiting or sleeping) to its base priority */
+    spin_lock(&process_lock);
+    for (i = 0; i < MAX_PIDS; i++)
+    {
+        if ((pcb = pid_table[i]))
+        {
+            pcb->priority = pcb->base_priority;
+            pcb->ticks_used = 0;
+        }
+    }
+    spin_unlock(&process_lock);
+    
+    /* Put the waiting processes back on the queues for their new priority */
+    while (waiting)
+    {
+        pcb = waiting;
+        waiting = pcb->run_next;
+        run_queue_add(pcb);
+    }
+}
+
+/*
+ * update_tick
+ *      SUMMARY: Arms the PIT for the next scheduler tick if anything is waiting
+ *       for the processor behind the running process, or if the time page
+ *       has no other clock (see clock_needs_tick). Otherwise the PIT is
+ *       left off, so idle periods and a lone runnable process take no
+ *       scheduler interrupts.
+ *       INPUTS: running -- the process that is (about to be) on the processor
+ *      OUTPUTS: none
+ * SIDE EFFECTS: sched_lock must be held
+ */
+static void update_tick(pcb_t* running)
+{
+    if (pit_armed())
+    {
+        return;
+    }
+    
+    if (clock_needs_tick() || ((running != IDLE_PCB) && (highest_waiting_priority(CURRENT_RUN_QUEUE) < NUM_PRIORITIES)))
+    {
+        pit_arm_tick();
+    }
+}
+
+/*
+ * notify_cpu
+ *      SUMMARY: Lets a processor know that a process was put on its run queue.
+ *       Another processor is sent a reschedule IPI, which arms its tick if it
+ *       is running something else or wakes its idle task out of hlt.
+ *       INPUTS: cpu -- index of the processor whose run queue was added to
+ *      OUTPUTS: none
+ * SIDE EFFECTS: sched_lock must be held
+ */
+static void notify_cpu(uint32_t cpu)
+{
+    if (cpu == CURRENT_CPU->id)
+    {
+        update_tick(CURRENT_PCB_ADDRESS);
+    }
+    else
+    {
+        lapic_send_ipi(cpus[cpu].apic_id, RESCHEDULE_INTERRUPT);
+    }
+}
+
+/*
+ * remote_wakeup
+ *      SUMMARY: Called by the reschedule IPI handler after another processor
+ *       put a process on this one's run queue. The running process needs a
+ *       tick to be preempted by; the idle task sees the process once the
+ *       interrupt has brought it out of hlt.
+ *       INPUTS: none
+ *      OUTPUTS: none
+ * SIDE EFFECTS: None
+ */
+void remote_wakeup(void)
+{
+    /* Local variables */
+    uint32_t flags; /* Save variable for flags */
+    
+    spin_lock_irqsave(&sched_lock, flags);
+    update_tick(CURRENT_PCB_ADDRESS);
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/*
+ * shells_wanted_here
+ *      SUMMARY: Finds the terminals waiting for a base shell that this
+ *       processor's idle task starts. Terminal i's shell runs on processor
+ *       i modulo the number of processors, so the shells run in parallel.
+ *       INPUTS: none
+ *      OUTPUTS: none
+ * RETURN VALUE: Bitmask of the terminals, like shells_wanted
+ * SIDE EFFECTS: sched_lock must be held
+ */
+static uint32_t shells_wanted_here(void)
+{
+    /* Local variables */
+    uint32_t mask = 0; /* Terminals this processor starts shells on */
+    uint32_t i;        /* Iteration variable */
+    
+    for (i = CURRENT_CPU->id; i < NUM_TERMINALS; i += num_cpus)
+    {
+        mask |= 1 << i;
+    }
+    
+    return shells_wanted & mask;
+}
+
+/*
+ * wake_process
+ *      SUMMARY: Makes a sleeping process runnable again. Since it gave up the
+ *       processor before using its quantum, it is promoted one level.
+ *       INPUTS: pcb -- the process to wake
+ *      OUTPUTS: none
+ * SIDE EFFECTS: sched_lock must be held
+ */
+void wake_process(pcb_t* pcb)
+{
+    if (pcb->priority > pcb->base_priority)
+    {
+        pcb->priority--;
+    }
+    pcb->ticks_used = 0;
+    pcb->state = TASK_RUNNABLE;
+    run_queue_add(pcb);
+    
+    /* The process running where it sleeps now has competition, so it needs a tick to be preempted by */
+    notify_cpu(pcb->cpu);
+}
+
+/*
+ * start_process
+ *      SUMMARY: Puts a new process on the run queue at its priority. Unlike a
+ *       process started by sys_execute, it doesn't take its parent's place,
+ *       so it goes to the processor with the fewest processes. Processes
+ *       never move between processors after that.
+ *       INPUTS: pcb -- the new process, with its context to switch to set up
+ *      OUTPUTS: none
+ * SIDE EFFECTS: None
+ */
+void start_process(pcb_t* pcb)
+{
+    /* Local variables */
+    uint32_t flags; /* Save variable for flags */
+    uint32_t i;     /* Iteration variable */
+    
+    spin_lock_irqsave(&sched_lock, flags);
+    
+    pcb->cpu = 0;
+    for (i = 1; i < num_cpus; i++)
+    {
+        if (cpus[i].nr_processes < cpus[pcb->cpu].nr_processes)
+        {
+            pcb->cpu = i;
+        }
+    }
+    cpus[pcb->cpu].nr_processes++;
+    
+    pcb->ticks_used = 0;
+    pcb->state = TASK_RUNNABLE;
+    run_queue_add(pcb);
+    notify_cpu(pcb->cpu);
+    
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/*
+ * exit_process
+ *      SUMMARY: Switches away from the current process for good. Used for
+ *       processes that no parent is waiting on in sys_execute. The process is
+ *       still running on its kernel stack here, so it is only freed once the
+ *       switch is done (see schedule_finish).
+ *       INPUTS: none
+ *      OUTPUTS: none
+ * SIDE EFFECTS: Never returns
+ */
+void exit_process(void)
+{
+    /* Local variables */
+    pcb_t* pcb = CURRENT_PCB_ADDRESS; /* The exiting process */
+    
+    cli();
+    spin_lock(&sched_lock);
+    
+    CURRENT_CPU->nr_processes--;
+    vm_switch(IDLE_PCB);
+    fpu_release(pcb);
+    pcb->state = TASK_EXITED;
+    CURRENT_CPU->dead = pcb;
+    
+    schedule_locked();
+}
+
+/*
+ * exit_base_shell
+ *      SUMMARY: Exits the current process, a base shell, and has the idle task
+ *       start a new shell on its terminal. The new shell can't be executed
+ *       from here, since that would run on the kernel stack being given up.
+ *       INPUTS: none
+ *      OUTPUTS: none
+ * SIDE EFFECTS: Never returns
+ */
+void exit_base_shell(void)
+{
+    /* Local variables */
+    pcb_t* pcb = CURRENT_PCB_ADDRESS; /* The exiting shell */
+    
+    cli();
+    spin_lock(&sched_lock);
+    shells_wanted |= 1 << pcb->terminal->terminal_number;
+    spin_unlock(&sched_lock);
+    
+    exit_process();
+}
+
+/*
+ * schedule_tail
+ *      SUMMARY: First thing a forked process runs when it is switched to. The
+ *       switch left sched_lock held, which would normally be released by
+ *       whatever the process was doing when it called into the scheduler.
+ *       INPUTS: none
+ *      OUTPUTS: none
+ * SIDE EFFECTS: Releases sched_lock
+ */
+void schedule_tail(void)
+{
+    spin_unlock(&sched_lock);
+}
+
+/*
+ * schedule_finish
+ *      SUMMARY: Runs on the next process's stack right after every switch, and
+ *       frees the process this processor switched away from if it exited
+ *       (see exit_process)
+ *       INPUTS: none
+ *      OUTPUTS: none
+ * SIDE EFFECTS: sched_lock must be held
+ */
+void schedule_finish(void)
+{
+    /* Local variables */
+    cpu_t* cpu = CURRENT_CPU; /* This processor */
+    pcb_t* dead = cpu->dead;  /* The process that exited, if any */
+    
+    if (dead)
+    {
+        cpu->dead = NULL;
+        process_free(dead);
+    }
+}
+
+/*
+ * set_base_priority
+ *      SUMMARY: Changes the base priority of the current process by the given
+ *       increment (larger levels are lower priority but get longer quanta)
+ *       and restarts it at that level
+ *       INPUTS: increment -- amount to move the base priority by; may be negative
+ *      OUTPUTS: none
+ * RETURN VALUE: The new base priority, or -1 for the idle task
+ */
+int32_t set_base_priority(int32_t increment)
+{
+    /* Local variables */
+    pcb_t* pcb = CURRENT_PCB_ADDRESS; /* The current process */
+    int32_t priority;                 /* The new base priority */
+    uint32_t flags;                   /* Save variable for flags */
+    
+    if (CURRENT_PID == IDLE_PID)
+    {
+        return -1;
+    }
+    
+    /* Start critical section */
+    spin_lock_irqsave(&sched_lock, flags);
+    
+    /* Clamp the new level to the ones that exist */
+    priority = (int32_t) pcb->base_priority + increment;
+    if (priority < 0)
+    {
+        priority = 0;
+    }
+    else if (priority >= NUM_PRIORITIES)
+    {
+        priority = NUM_PRIORITIES - 1;
+    }
+    
+    pcb->base_priority = priority;
+    pcb->priority = priority;
+    pcb->ticks_used = 0;
+    
+    /* End critical section */
+    spin_unlock_irqrestore(&sched_lock, flags);
+    
+    return priority;
 }
 
 /*
  * schedule
- *      SUMMARY: Function called by the PIT interrupt handler. Switches between tasks
- *       every ~25 ms.
+ *      SUMMARY: Function called by the PIT interrupt handler, which only fires
+ *       (every ~25 ms) while processes are competing for the processor, or
+ *       all the time if the time page needs it (see clock_needs_tick). Takes
+ *       sched_lock and lets schedule_locked decide whether to switch.
  *       INPUTS: none
  *      OUTPUTS: none
- * SIDE EFFECTS: Kicks off scheduling algorithm 
+ * SIDE EFFECTS: May switch to another process
  */
 void schedule(void)
 {
     /* Local variables */
-    task_t* curr; /* Pointer to the current and next task structures */
-    task_t* next;
+    uint32_t flags; /* Save variable for flags */
+    
+    spin_lock_irqsave(&sched_lock, flags);
+    pit_interrupt_counter++;
+    clock_tick();
+    schedule_locked();
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
 
-    /* Getting the current task */
-    curr = &(CURRENT_TASK);
+/*
+ * schedule_locked
+ *      SUMMARY: Picks the next process to run and switches to it. Called from
+ *       schedule for PIT ticks, by the wait queues to give up the processor and
+ *       by the idle task. A runnable process other than the idle task only gets
+ *       here from the PIT, so that case is charged a tick of its quantum. A
+ *       process that uses its whole quantum is demoted to the next level, which
+ *       has a longer quantum.
+ *       INPUTS: none
+ *      OUTPUTS: none
+ * SIDE EFFECTS: sched_lock must be held. It stays held across the switch and
+ *       is released by whatever the next process was doing when it called in.
+ *       Returns without switching if the current process still has quantum
+ *       left and nothing of a higher priority is waiting. Switches to the idle
+ *       task if the current process blocked and nothing else is runnable.
+ */
+void schedule_locked(void)
+{
+    /* Local variables */
+    pcb_t* curr; /* Pointer to the current and next process PCBs */
+    pcb_t* next;
+    terminal_t* terminal; /* Terminal that needs a shell started on it */
+    uint32_t i;           /* Index of that terminal */
+    uint32_t expired;     /* Flag for whether the current process used up its quantum */
+    uint32_t waiting;     /* Highest priority level with a process waiting on it */
+
+    /* Getting the current process */
+    curr = CURRENT_PCB_ADDRESS;
     
-    /* Start critical section */
-    cli_and_save(curr->flags);
+    /* Periodically put everything back at its base priority */
+    if (pit_interrupt_counter - last_boost >= BOOST_INTERVAL)
+    {
+        last_boost = pit_interrupt_counter;
+        boost_priorities();
+    }
+    
+    /* Charge the running process for the tick, demoting it if its quantum is used up */
+    expired = FALSE;
+    if ((curr->state == TASK_RUNNABLE) && (curr != IDLE_PCB))
+    {
+        curr->ticks_used++;
+        if (curr->ticks_used >= QUANTUM(curr->priority))
+        {
+            if (curr->priority < NUM_PRIORITIES - 1)
+            {
+                curr->priority++;
+            }
+            curr->ticks_used = 0;
+            expired = TRUE;
+        }
+    }
+    
+    waiting = highest_waiting_priority(CURRENT_RUN_QUEUE);
+    
+    /* Stay on the current process unless something of a higher priority is waiting,
+     * or it used up its quantum and something of the same priority is waiting */
+    if (curr->state == TASK_RUNNABLE)
+    {
+        if (curr == IDLE_PCB)
+        {
+            /* The idle task also gets here when a terminal still needs its shell */
+            if ((waiting == NUM_PRIORITIES) && !shells_wanted_here())
+            {
+                update_tick(curr);
+                return;
+            }
+        }
+        else if ((waiting > curr->priority) || ((waiting == curr->priority) && !expired))
+        {
+            update_tick(curr);
+            clock_update(curr);
+            return;
+        }
+    }
     
     /* Getting the values of esp and ebp for scheduling */
     asm volatile ("        \n\
             movl %%esp, %0 \n\
             movl %%ebp, %1 \n\
             "
-            : "=r"(curr->pcb->schedule_esp), "=r"(curr->pcb->schedule_ebp)
+            : "=r"(curr->schedule_esp), "=r"(curr->schedule_ebp)
             : 
     );
     
     /* Storing the value of ESP0 */
-    curr->pcb->schedule_esp0 = tss.esp0;
-
-    /* Advance to and get the next task */
-    current_task = (current_task + 1) % NUM_TASKS;
-    next = &(CURRENT_TASK);
+    curr->schedule_esp0 = CURRENT_CPU->tss->esp0;
+    
+    /* A preempted process goes to the back of the line for its priority; the idle task is never queued */
+    if ((curr->state == TASK_RUNNABLE) && (curr != IDLE_PCB))
+    {
+        run_queue_add(curr);
+    }
 
-    /* Remap kernel and user video memory if the next tasks terminal is the active terminal */
-    if(next->terminal->active)
+    /* The idle task starts a shell on the next terminal that doesn't have one.
+     * Its context is saved above, so it resumes here once nothing else can run. */
+    if ((curr == IDLE_PCB) && shells_wanted_here())
     {
-        map_virt_to_phys((uint8_t*)VIDMEM,(uint8_t*)VIDMEM);
-        map_virt_to_phys((uint8_t*)VIRTUAL_END,(uint8_t*)VIDMEM);
+        for (i = 0; !(shells_wanted_here() & (1 << i)); i++);
+        shells_wanted &= ~(1 << i);
+        terminal = &(terminals[i]);
+        spin_unlock(&sched_lock);
+        send_eoi(PIT_IRQ);
+        start_base_shell(terminal);
+        
+        /* Only reached if the shell couldn't be started */
+        spin_lock(&sched_lock);
     }
-    else
+    
+    /* Get the next process, falling back to the idle task */
+    next = run_queue_pop(CURRENT_RUN_QUEUE);
+    if (!next)
     {
-        map_virt_to_phys((uint8_t*)VIDMEM,(uint8_t*)next->terminal->video_mem);
-        map_virt_to_phys((uint8_t*)VIRTUAL_END,(uint8_t*)next->terminal->video_mem);
+        next = IDLE_PCB;
     }
     
-    /* Update the video params to next terminal's */
-    get_video_params(&(curr->terminal->screen_x), &(curr->terminal->screen_y));
-    set_video_params(next->terminal->screen_x, next->terminal->screen_y);
+    /* Restore important/"global" data */
+    CURRENT_PID = next->pid;
+    CURRENT_CPU->tss->esp0 = next->schedule_esp0;
+    clock_update(next);
     
-    //need to update 4mB user memory page every time process switch occurs
-    uint32_t new_phys_addr = (PID_OFFSET + next->pid) * FOUR_M;
-    page_modify(VIRTUAL_BEGIN, new_phys_addr, USER_PRIV);
-    flush_TLB();
-
-    /* If the next task has not yet been started, then we must start a shell on it */
-    if (!next->started)
+    /* The idle task never touches user or video memory, so leave it mapped as
+     * is. The kernel writes to terminals through their own storage (see
+     * lib.c), so only the user's video memory needs to follow the process. */
+    if (next->terminal)
     {
-        next->started = TRUE;
-        send_eoi(PIT_IRQ);
-        sys_execute((uint8_t*)"shell");
+        terminal_map_vidmap(next->terminal);
+        
+        //need to swap in the user page table every time process switch occurs
+        vm_switch(next);
     }
     
-    /* Restore important/"global" data */
-    global_pid = next->pid;
-    tss.esp0 = next->pcb->schedule_esp0;
+    /* Only keep the PIT running if the next process has to share the processor */
+    update_tick(next);
     
-    /* Update the cursor on the active terminal */
-    update_cursor_active();
+    /* Make the next process trap on the FPU if its state isn't loaded */
+    fpu_switch_to(next);
     
-    /* End critical section */
-    restore_flags(next->flags);
+    /* The next process may not resume inside the PIT handler (e.g. if it was
+     * sleeping on a wait queue), so acknowledge the PIT before switching */
+    send_eoi(PIT_IRQ);
     
-    /* Context switch using the next tasks ESP and EBP to switch into other task */
-    asm volatile ("        \n\
-            movl %0, %%esp \n\
-            movl %1, %%ebp \n\
-            leave          \n\
-            ret            \n\
+    /* Context switch using the next process's ESP and EBP to switch into it,
+     * then free the current process if it exited. Interrupts stay off until
+     * the next process releases sched_lock. */
+    asm volatile ("               \n\
+            movl %0, %%esp        \n\
+            movl %1, %%ebp        \n\
+            call schedule_finish  \n\
+            leave                 \n\
+            ret                   \n\
             "
             : 
-            : "r"(next->pcb->schedule_esp), "r"(next->pcb->schedule_ebp)
+            : "r"(next->schedule_esp), "r"(next->schedule_ebp)
             : "esp", "ebp"
     );
     
 }
-
-
@@ -7,41 +7,81 @@
 #include "types.h"
 #include "process.h"
 #include "terminal.h"
+#include "spinlock.h"
+#include "cpu.h"
 
-/* Number of tasks that can run in the scheduler (should be the same as NUM_TERMINALS) */
-#define NUM_TASKS 0x03
+/* Values for the state of a process */
+#define TASK_RUNNABLE 0x00 /* The process is running or waiting on the run queue */
+#define TASK_BLOCKED  0x01 /* The process is sleeping on a wait queue */
+#define TASK_EXITED   0x02 /* The process has halted and is never run again */
 
-/* Macro to abstract indexing into the task array */
-#define CURRENT_TASK tasks[current_task]
+/* Number of levels in the multi-level feedback queue (0 is the highest priority) */
+#define NUM_PRIORITIES 0x04
 
-/* Task struct for use with scheduler */
-typedef struct {
-    pcb_t* pcb; /* Pointer to the PCB of the process currently executing in the task */
-    uint32_t started; /* Flag for determining if a terminal/shell has been started in the task */
-    uint32_t flags; /* Save value of the flags */
-    uint32_t pid; /* PID of the process that is currently executing in the task */
-    terminal_t* terminal; /* Pointer to the terminal struct of the current task */
-} task_t;
+/* Length of a quantum in PIT ticks at the highest priority; it doubles at each level below */
+#define BASE_QUANTUM 0x01
+#define QUANTUM(priority) (BASE_QUANTUM << (priority))
 
-/* Array of the task structures */
-task_t tasks[NUM_TASKS];
+/* Number of PIT ticks between boosting every process back to its base priority
+ * (1s of contention; the PIT only ticks while processes contend, or all the
+ * time without a TSC, and the ticks of every processor count towards it) */
+#define BOOST_INTERVAL 40
 
-/* Index into the task array */
-uint32_t current_task;
+/* Macro which returns the pointer to the idle task's PCB */
+#define IDLE_PCB (PCB_ADDRESS(IDLE_PID))
 
-// Global vars for use with handlers, shell startup, virtualization, etc.
-extern int pcb_all_started;
+/* Run queue of one processor, with a FIFO of waiting processes for each priority level */
+typedef struct run_queue {
+    pcb_t* head[NUM_PRIORITIES]; /* Next process to run at each level */
+    pcb_t* tail[NUM_PRIORITIES]; /* Last process to have been added at each level */
+} run_queue_t;
+
+/* Macro which returns the pointer to this processor's run queue */
+#define CURRENT_RUN_QUEUE (&(run_queues[CURRENT_CPU->id]))
+
+/* Lock protecting the run queues, the state of every process and the wait queues */
+extern spinlock_t sched_lock;
 
 /* Flag for determining if scheduling has started or not */
 volatile uint32_t scheduling_started;
 
-/* Counter for tracking number of interrupts from the PIT */
+/* Counter for tracking number of scheduler ticks on every processor (under sched_lock) */
 extern int pit_interrupt_counter;
 
-/* Start the PIT and execute the first shell */
+/* Start the PIT and turn the boot context into the idle task */
 extern void start_scheduler(void);
 
+/* Turn the boot context of an application processor into its idle task */
+extern void start_scheduler_ap(void);
+
+/* Called when another processor put a process on this one's run queue */
+extern void remote_wakeup(void);
+
 /* Function for PIT interrupts */
 extern void schedule(void);
 
+/* Pick the next process and switch to it; sched_lock must be held */
+extern void schedule_locked(void);
+
+/* Make a process that was sleeping runnable again, promoting it one level; sched_lock must be held */
+extern void wake_process(pcb_t* pcb);
+
+/* Put a new process (made by sys_fork) on the run queue */
+extern void start_process(pcb_t* pcb);
+
+/* Free the current process and switch away from it for good */
+extern void exit_process(void);
+
+/* Free the current base shell and have a new one started on its terminal */
+extern void exit_base_shell(void);
+
+/* Release sched_lock in a new process that was switched to for the first time */
+extern void schedule_tail(void);
+
+/* Free the process this processor just switched away from, if it exited */
+extern void schedule_finish(void);
+
+/* Change the base priority of the current process */
+extern int32_t set_base_priority(int32_t increment);
+
 #endif
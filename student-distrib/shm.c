@@ -0,0 +1,245 @@
+/* shm.c - Functions for shared memory segments
+ * vim:ts=4 noexpandtab
+ */
+
+#include "shm.h"
+#include "process.h"
+#include "frame.h"
+#include "paging.h"
+#include "spinlock.h"
+#include "lib.h"
+
+static void shm_destroy(shm_segment_t* segment);
+
+static shm_segment_t shm_segments[MAX_SHM_SEGMENTS];
+
+/* Lock protecting the segment table */
+static spinlock_t shm_lock = SPINLOCK_UNLOCKED;
+
+/*
+ * shm_create
+ *   DESCRIPTION: Finds the segment with a key, or creates it with zeroed
+ *                frames if there is none. A new segment belongs to its creator
+ *                until somebody maps it; after that it lasts as long as it is
+ *                mapped somewhere. Finding a segment takes no reference, so
+ *                it can go away before the finder maps it; shm_map then
+ *                refuses the stale ID.
+ *   INPUTS: key: Key that processes agree on for the segment
+ *           size: Bytes the segment needs (rounded up to pages)
+ *           owner: Process creating the segment
+ *   OUTPUTS: None
+ *   RETURN VALUE: ID of the segment, or -1 if the size is invalid, an existing
+ *                 segment is too small, or there's no room
+ *   SIDE EFFECTS: None
+ */
+int32_t shm_create(uint32_t key, uint32_t size, pcb_t* owner)
+{
+    /* Local variables */
+    shm_segment_t* segment; /* Segment being created */
+    uint32_t num_pages;     /* Pages the segment needs */
+    int32_t id;             /* ID of the segment */
+    int32_t free_id = -1;   /* ID of a free slot */
+    uint32_t flags;         /* Save variable for flags */
+    uint32_t i;
+
+    if (!size || (size > SHM_MAX_PAGES * PAGE_SIZE))
+    {
+        return -1;
+    }
+    num_pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    spin_lock_irqsave(&shm_lock, flags);
+
+    for (id = 0; id < MAX_SHM_SEGMENTS; id++)
+    {
+        if (!shm_segments[id].num_pages)
+        {
+            if (free_id == -1)
+            {
+                free_id = id;
+            }
+        }
+        else if (shm_segments[id].key == key)
+        {
+            spin_unlock_irqrestore(&shm_lock, flags);
+            return (shm_segments[id].num_pages >= num_pages) ? (int32_t)((shm_segments[id].seq << SHM_ID_SHIFT) | id) : -1;
+        }
+    }
+
+    if (free_id == -1)
+    {
+        spin_unlock_irqrestore(&shm_lock, flags);
+        return -1;
+    }
+
+    segment = &shm_segments[free_id];
+    for (i = 0; i < num_pages; i++)
+    {
+        if (!(segment->frames[i] = frame_alloc(FRAME_ORDER_4K)))
+        {
+            while (i--)
+            {
+                frame_free(segment->frames[i], FRAME_ORDER_4K);
+            }
+            spin_unlock_irqrestore(&shm_lock, flags);
+            return -1;
+        }
+        memset((void*)segment->frames[i], 0, PAGE_SIZE);
+    }
+    segment->key = key;
+    segment->num_pages = num_pages;
+    segment->refs = 0;
+    segment->owner = owner;
+    segment->seq = (segment->seq + 1) & SHM_SEQ_MASK;
+
+    spin_unlock_irqrestore(&shm_lock, flags);
+    return (int32_t)((segment->seq << SHM_ID_SHIFT) | free_id);
+}
+
+/*
+ * shm_map
+ *   DESCRIPTION: Maps every page of a segment into a process, writable and
+ *                shared with every other mapping
+ *   INPUTS: pcb: The process, which must be the one mapped in
+ *           id: ID of the segment
+ *           address: Where the segment goes in the user window (page aligned)
+ *   OUTPUTS: None
+ *   RETURN VALUE: 0 on success, -1 if the ID is invalid (or its segment is
+ *                 gone) or the segment doesn't fit at the address
+ *   SIDE EFFECTS: None
+ */
+int32_t shm_map(pcb_t* pcb, int32_t id, uint32_t address)
+{
+    /* Local variables */
+    shm_segment_t* segment; /* Segment being mapped */
+    uint32_t flags;         /* Save variable for flags */
+
+    if (id < 0)
+    {
+        return -1;
+    }
+    segment = &shm_segments[SHM_SLOT(id)];
+
+    /* The reference keeps the segment around while it is mapped in */
+    spin_lock_irqsave(&shm_lock, flags);
+    if (!segment->num_pages || (segment->seq != ((uint32_t)id >> SHM_ID_SHIFT)))
+    {
+        spin_unlock_irqrestore(&shm_lock, flags);
+        return -1;
+    }
+    segment->refs++;
+    segment->owner = NULL;
+    spin_unlock_irqrestore(&shm_lock, flags);
+
+    if (vm_map_shared(pcb, address, segment->frames, segment->num_pages, id) == -1)
+    {
+        shm_put(id);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * shm_unmap
+ *   DESCRIPTION: Unmaps a segment from a process, freeing it if that was its
+ *                last mapping
+ *   INPUTS: pcb: The process, which must be the one mapped in
+ *           address: Address the segment was mapped at
+ *   OUTPUTS: None
+ *   RETURN VALUE: 0 on success, -1 if no segment is mapped there
+ *   SIDE EFFECTS: None
+ */
+int32_t shm_unmap(pcb_t* pcb, uint32_t address)
+{
+    int32_t id;
+
+    if ((id = vm_unmap_shared(pcb, address)) == -1)
+    {
+        return -1;
+    }
+    shm_put(id);
+    return 0;
+}
+
+/*
+ * shm_get
+ *   DESCRIPTION: Takes another reference to a segment, for a mapping that fork
+ *                copied into a child
+ *   INPUTS: id: ID of the segment, which must already be mapped
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void shm_get(int32_t id)
+{
+    uint32_t flags;
+
+    spin_lock_irqsave(&shm_lock, flags);
+    shm_segments[SHM_SLOT(id)].refs++;
+    spin_unlock_irqrestore(&shm_lock, flags);
+}
+
+/*
+ * shm_put
+ *   DESCRIPTION: Drops a reference to a segment, freeing it with the last one
+ *   INPUTS: id: ID of the segment
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void shm_put(int32_t id)
+{
+    uint32_t flags;
+
+    spin_lock_irqsave(&shm_lock, flags);
+    if (!--shm_segments[SHM_SLOT(id)].refs)
+    {
+        shm_destroy(&shm_segments[SHM_SLOT(id)]);
+    }
+    spin_unlock_irqrestore(&shm_lock, flags);
+}
+
+/*
+ * shm_exit
+ *   DESCRIPTION: Frees the segments a process created that were never mapped,
+ *                since nothing else holds them
+ *   INPUTS: pcb: The exiting process
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void shm_exit(pcb_t* pcb)
+{
+    uint32_t flags;
+    uint32_t id;
+
+    spin_lock_irqsave(&shm_lock, flags);
+    for (id = 0; id < MAX_SHM_SEGMENTS; id++)
+    {
+        if (shm_segments[id].num_pages && (shm_segments[id].owner == pcb))
+        {
+            shm_destroy(&shm_segments[id]);
+        }
+    }
+    spin_unlock_irqrestore(&shm_lock, flags);
+}
+
+/*
+ * shm_destroy
+ *   DESCRIPTION: Frees a segment's frames and its slot. The lock must be held.
+ *   INPUTS: segment: The segment, which nobody has mapped
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+static void shm_destroy(shm_segment_t* segment)
+{
+    uint32_t i;
+
+    for (i = 0; i < segment->num_pages; i++)
+    {
+        frame_free(segment->frames[i], FRAME_ORDER_4K);
+    }
+    segment->num_pages = 0;
+    segment->owner = NULL;
+}
@@ -0,0 +1,52 @@
+/* shm.h - Defines used for shared memory segments
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SHM_H
+#define _SHM_H
+
+#include "types.h"
+
+/* Most segments that can exist at once */
+#define MAX_SHM_SEGMENTS 0x10
+
+/* Most pages a segment can have (64KB) */
+#define SHM_MAX_PAGES 0x10
+
+/* A segment's ID is its slot plus how many segments the slot has held, so
+ * the ID of a segment that is gone can't map whatever took its slot */
+#define SHM_ID_SHIFT 4
+#define SHM_SEQ_MASK 0x07FFFFFF
+#define SHM_SLOT(id) ((id) & (MAX_SHM_SEGMENTS - 1))
+
+/* Physical frames that any number of processes can map into their user windows */
+typedef struct shm_segment {
+    uint32_t key;                   /* Key processes find the segment by */
+    uint32_t num_pages;             /* Size of the segment in pages (0 if the slot is free) */
+    uint32_t refs;                  /* Number of mappings of the segment */
+    struct pcb* owner;              /* Process that created the segment, until it is first mapped */
+    uint32_t seq;                   /* Number of segments the slot has held, the top of the ID */
+    uint32_t frames[SHM_MAX_PAGES]; /* Frame of each page */
+} shm_segment_t;
+
+struct pcb;
+
+/* Find or create the segment with a key; returns its ID, or -1 */
+extern int32_t shm_create(uint32_t key, uint32_t size, struct pcb* owner);
+
+/* Map a segment into a process at a page aligned address; returns 0, or -1 */
+extern int32_t shm_map(struct pcb* pcb, int32_t id, uint32_t address);
+
+/* Unmap the segment a process has mapped at an address; returns 0, or -1 */
+extern int32_t shm_unmap(struct pcb* pcb, uint32_t address);
+
+/* Take another reference to a segment (for a mapping copied by fork) */
+extern void shm_get(int32_t id);
+
+/* Drop a reference to a segment, freeing it with the last one */
+extern void shm_put(int32_t id);
+
+/* Free the segments an exiting process created but nobody mapped */
+extern void shm_exit(struct pcb* pcb);
+
+#endif /* _SHM_H */
@@ -0,0 +1,403 @@
+/* slab.c - Functions for the kernel's object caches and kmalloc
+ * vim:ts=4 noexpandtab
+ */
+
+#include "slab.h"
+#include "frame.h"
+#include "lib.h"
+
+/* Cache for the headers of off-slab slabs (its own slabs keep their headers on-slab) */
+static kmem_cache_t slab_header_cache = KMEM_CACHE("slab_header", sizeof(slab_t), 0);
+
+/* Caches backing kmalloc, one for each power of two size */
+static kmem_cache_t kmalloc_caches[NUM_KMALLOC_CACHES] = {
+    KMEM_CACHE("kmalloc-32",     0x00020, 0),
+    KMEM_CACHE("kmalloc-64",     0x00040, 0),
+    KMEM_CACHE("kmalloc-128",    0x00080, 0),
+    KMEM_CACHE("kmalloc-256",    0x00100, 0),
+    KMEM_CACHE("kmalloc-512",    0x00200, 0),
+    KMEM_CACHE("kmalloc-1024",   0x00400, 0),
+    KMEM_CACHE("kmalloc-2048",   0x00800, 0),
+    KMEM_CACHE("kmalloc-4096",   0x01000, 0),
+    KMEM_CACHE("kmalloc-8192",   0x02000, 0),
+    KMEM_CACHE("kmalloc-16384",  0x04000, 0),
+    KMEM_CACHE("kmalloc-32768",  0x08000, 0),
+    KMEM_CACHE("kmalloc-65536",  0x10000, 0),
+    KMEM_CACHE("kmalloc-131072", 0x20000, 0)
+};
+
+/* Slab that each page of low memory belongs to (NULL if none) */
+static slab_t* page_slabs[DIRECT_MAP_PAGES];
+
+/* Every cache that has been used, for the statistics */
+static kmem_cache_t* cache_list = NULL;
+static spinlock_t cache_list_lock = SPINLOCK_UNLOCKED;
+
+static void cache_setup(kmem_cache_t* cache);
+static slab_t* slab_create(kmem_cache_t* cache);
+static void slab_destroy(kmem_cache_t* cache, slab_t* slab);
+static void slab_list_add(slab_t** list, slab_t* slab);
+static void slab_list_remove(slab_t** list, slab_t* slab);
+
+/*
+ * cache_setup
+ *   DESCRIPTION: Works out the layout of a cache's slabs the first time it is
+ *                used. Objects of at least a cache line are aligned to one, and
+ *                smaller ones to a power of two at least their size, so no
+ *                object straddles a cache line it doesn't need to. Slabs are
+ *                the smallest size that holds SLAB_MIN_OBJECTS objects, up to
+ *                SLAB_MAX_ORDER.
+ *   INPUTS: cache: The cache to set up
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: The cache's lock must be held. Adds the cache to the statistics list.
+ */
+static void cache_setup(kmem_cache_t* cache)
+{
+    /* Local variables */
+    uint32_t align; /* Alignment of every object */
+    uint32_t size;  /* Padded object size */
+    uint32_t order; /* Order of each slab */
+
+    align = cache->align;
+    if (!align)
+    {
+        if (cache->object_size >= CACHE_LINE_SIZE)
+        {
+            align = CACHE_LINE_SIZE;
+        }
+        else
+        {
+            for (align = sizeof(void*); align < cache->object_size; align <<= 1);
+        }
+    }
+
+    /* Free objects hold the free list link, so they can't be smaller than a pointer */
+    size = (cache->object_size < sizeof(void*)) ? sizeof(void*) : cache->object_size;
+    size = (size + align - 1) & ~(align - 1);
+
+    cache->off_slab = (size >= OFF_SLAB_SIZE);
+    cache->first_offset = cache->off_slab ? 0 : ((sizeof(slab_t) + align - 1) & ~(align - 1));
+
+    order = 0;
+    while ((ORDER_SIZE(order) < cache->first_offset + size) ||
+            ((order < SLAB_MAX_ORDER) && ((ORDER_SIZE(order) - cache->first_offset) / size < SLAB_MIN_OBJECTS)))
+    {
+        order++;
+    }
+    cache->slab_order = order;
+    cache->objects_per_slab = (ORDER_SIZE(order) - cache->first_offset) / size;
+    cache->size = size;
+
+    spin_lock(&cache_list_lock);
+    cache->next_cache = cache_list;
+    cache_list = cache;
+    spin_unlock(&cache_list_lock);
+}
+
+/*
+ * slab_create
+ *   DESCRIPTION: Takes frames for a new slab and chains its objects onto its
+ *                free list, lowest address first
+ *   INPUTS: cache: The cache that needs another slab
+ *   OUTPUTS: None
+ *   RETURN VALUE: The new slab, or NULL if memory is full
+ *   SIDE EFFECTS: The cache's lock must be held
+ */
+static slab_t* slab_create(kmem_cache_t* cache)
+{
+    /* Local variables */
+    slab_t* slab;   /* The new slab */
+    uint32_t base;  /* Address of the slab's frames */
+    void** object;  /* Object being put on the free list */
+    uint32_t i;     /* Iteration variable */
+
+    if (!(base = frame_alloc(cache->slab_order)))
+    {
+        return NULL;
+    }
+
+    if (cache->off_slab)
+    {
+        if (!(slab = kmem_cache_alloc(&slab_header_cache)))
+        {
+            frame_free(base, cache->slab_order);
+            return NULL;
+        }
+    }
+    else
+    {
+        slab = (slab_t*)base;
+    }
+
+    slab->cache = cache;
+    slab->next = NULL;
+    slab->prev = NULL;
+    slab->free = NULL;
+    slab->in_use = 0;
+    slab->base = base;
+
+    for (i = cache->objects_per_slab; i > 0; i--)
+    {
+        object = (void**)(base + cache->first_offset + (i - 1) * cache->size);
+        *object = slab->free;
+        slab->free = object;
+    }
+
+    for (i = 0; i < (1 << cache->slab_order); i++)
+    {
+        page_slabs[(base >> PAGE_SHIFT) + i] = slab;
+    }
+
+    cache->num_slabs++;
+    cache->total_objects += cache->objects_per_slab;
+    return slab;
+}
+
+/*
+ * slab_destroy
+ *   DESCRIPTION: Gives an empty slab's frames (and header) back
+ *   INPUTS: cache: The cache the slab belongs to
+ *           slab: The slab, which must not be on any list
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: The cache's lock must be held
+ */
+static void slab_destroy(kmem_cache_t* cache, slab_t* slab)
+{
+    uint32_t base = slab->base;
+    uint32_t i;
+
+    for (i = 0; i < (1 << cache->slab_order); i++)
+    {
+        page_slabs[(base >> PAGE_SHIFT) + i] = NULL;
+    }
+
+    if (cache->off_slab)
+    {
+        kmem_cache_free(&slab_header_cache, slab);
+    }
+    frame_free(base, cache->slab_order);
+
+    cache->num_slabs--;
+    cache->total_objects -= cache->objects_per_slab;
+}
+
+/*
+ * slab_list_add
+ *   DESCRIPTION: Puts a slab at the front of one of a cache's slab lists
+ *   INPUTS: list: The list to add to
+ *           slab: The slab to add
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: The cache's lock must be held
+ */
+static void slab_list_add(slab_t** list, slab_t* slab)
+{
+    slab->prev = NULL;
+    slab->next = *list;
+    if (slab->next)
+    {
+        slab->next->prev = slab;
+    }
+    *list = slab;
+}
+
+/*
+ * slab_list_remove
+ *   DESCRIPTION: Takes a slab off one of a cache's slab lists
+ *   INPUTS: list: The list the slab is on
+ *           slab: The slab to remove
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: The cache's lock must be held
+ */
+static void slab_list_remove(slab_t** list, slab_t* slab)
+{
+    if (slab->prev)
+    {
+        slab->prev->next = slab->next;
+    }
+    else
+    {
+        *list = slab->next;
+    }
+    if (slab->next)
+    {
+        slab->next->prev = slab->prev;
+    }
+    slab->next = NULL;
+    slab->prev = NULL;
+}
+
+/*
+ * kmem_cache_alloc
+ *   DESCRIPTION: Pops an object off the free list of a partially used slab,
+ *                falling back on the kept empty slab and then a new one
+ *   INPUTS: cache: The cache to allocate from
+ *   OUTPUTS: None
+ *   RETURN VALUE: The object, or NULL if memory is full. Its contents are undefined.
+ *   SIDE EFFECTS: None
+ */
+void* kmem_cache_alloc(kmem_cache_t* cache)
+{
+    /* Local variables */
+    slab_t* slab;   /* Slab the object comes from */
+    void* object;   /* The object handed out */
+    uint32_t flags; /* Save variable for flags */
+
+    spin_lock_irqsave(&cache->lock, flags);
+
+    if (!cache->size)
+    {
+        cache_setup(cache);
+    }
+
+    slab = cache->partial;
+    if (!slab)
+    {
+        if ((slab = cache->empty))
+        {
+            cache->empty = NULL;
+        }
+        else if (!(slab = slab_create(cache)))
+        {
+            cache->failed_allocs++;
+            spin_unlock_irqrestore(&cache->lock, flags);
+            return NULL;
+        }
+        slab_list_add(&cache->partial, slab);
+    }
+
+    object = slab->free;
+    slab->free = *((void**)object);
+    slab->in_use++;
+    if (!slab->free)
+    {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_add(&cache->full, slab);
+    }
+
+    cache->active_objects++;
+    cache->num_allocs++;
+
+    spin_unlock_irqrestore(&cache->lock, flags);
+    return object;
+}
+
+/*
+ * kmem_cache_free
+ *   DESCRIPTION: Pushes an object back on its slab's free list. A slab that
+ *                becomes empty is kept if the cache has no empty slab yet,
+ *                otherwise its frames are given back.
+ *   INPUTS: cache: The cache the object came from
+ *           object: The object
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void kmem_cache_free(kmem_cache_t* cache, void* object)
+{
+    /* Local variables */
+    slab_t* slab;   /* Slab the object belongs to */
+    uint32_t flags; /* Save variable for flags */
+
+    slab = page_slabs[(uint32_t)object >> PAGE_SHIFT];
+
+    spin_lock_irqsave(&cache->lock, flags);
+
+    if (!slab->free)
+    {
+        slab_list_remove(&cache->full, slab);
+        slab_list_add(&cache->partial, slab);
+    }
+
+    *((void**)object) = slab->free;
+    slab->free = object;
+    slab->in_use--;
+
+    if (!slab->in_use)
+    {
+        slab_list_remove(&cache->partial, slab);
+        if (cache->empty)
+        {
+            slab_destroy(cache, slab);
+        }
+        else
+        {
+            cache->empty = slab;
+        }
+    }
+
+    cache->active_objects--;
+    cache->num_frees++;
+
+    spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+/*
+ * kmalloc
+ *   DESCRIPTION: Allocates memory from the smallest kmalloc cache that fits
+ *   INPUTS: size: Number of bytes needed
+ *   OUTPUTS: None
+ *   RETURN VALUE: The memory, or NULL if size is 0, over 128KB, or memory is full
+ *   SIDE EFFECTS: None
+ */
+void* kmalloc(uint32_t size)
+{
+    uint32_t i;
+
+    if (!size)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < NUM_KMALLOC_CACHES; i++)
+    {
+        if (size <= (1 << (KMALLOC_MIN_SHIFT + i)))
+        {
+            return kmem_cache_alloc(&kmalloc_caches[i]);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * kfree
+ *   DESCRIPTION: Frees memory from kmalloc, finding its cache from its slab
+ *   INPUTS: ptr: The memory (NULL is ignored)
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void kfree(void* ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    kmem_cache_free(page_slabs[(uint32_t)ptr >> PAGE_SHIFT]->cache, ptr);
+}
+
+/*
+ * kmem_print_stats
+ *   DESCRIPTION: Prints a line of usage statistics for every cache that has been used
+ *   INPUTS: None
+ *   OUTPUTS: The statistics, on the screen
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void kmem_print_stats(void)
+{
+    kmem_cache_t* cache;
+
+    for (cache = cache_list; cache; cache = cache->next_cache)
+    {
+        printf("%s: %u/%u objects of %uB, %u slabs of %uKB, %u allocs, %u frees, %u failed\n",
+                cache->name, cache->active_objects, cache->total_objects, cache->size,
+                cache->num_slabs, ORDER_SIZE(cache->slab_order) >> KB_SHIFT,
+                cache->num_allocs, cache->num_frees, cache->failed_allocs);
+    }
+}
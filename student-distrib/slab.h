@@ -0,0 +1,86 @@
+/* slab.h - Defines used for the kernel's object caches and kmalloc
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include "types.h"
+#include "spinlock.h"
+
+/* Objects at least this big start on a cache line, so two never share one */
+#define CACHE_LINE_SIZE 64
+
+/* Objects at least this big keep their slab's header out of the slab */
+#define OFF_SLAB_SIZE 0x200
+
+/* Slabs are made big enough for this many objects, up to the largest slab order */
+#define SLAB_MIN_OBJECTS 8
+#define SLAB_MAX_ORDER 3
+
+/* Sizes kmalloc has caches for, from 32B to 128KB */
+#define KMALLOC_MIN_SHIFT 5
+#define KMALLOC_MAX_SHIFT 17
+#define NUM_KMALLOC_CACHES (KMALLOC_MAX_SHIFT - KMALLOC_MIN_SHIFT + 1)
+
+struct kmem_cache;
+
+/* A run of frames carved into objects of one cache */
+typedef struct slab {
+    struct kmem_cache* cache; /* Cache the slab belongs to */
+    struct slab* next;        /* Neighbours on the cache's partial, full or empty list */
+    struct slab* prev;
+    void* free;               /* Free objects, linked through their first word */
+    uint32_t in_use;          /* Number of objects handed out */
+    uint32_t base;            /* Address of the slab's frames */
+} slab_t;
+
+/* A cache of objects of one type and size */
+typedef struct kmem_cache {
+    const int8_t* name;        /* Name shown in the statistics */
+    uint32_t object_size;      /* Size that was asked for */
+    uint32_t align;            /* Alignment that was asked for (0 for the default) */
+    uint32_t size;             /* Size of each object after padding for alignment; 0 until first use */
+    uint32_t slab_order;       /* Each slab is 4KB << slab_order */
+    uint32_t objects_per_slab; /* Number of objects in each slab */
+    uint32_t first_offset;     /* Offset of the first object in a slab */
+    uint32_t off_slab;         /* Flag for whether slab headers come from their own cache */
+    slab_t* partial;           /* Slabs with some objects free */
+    slab_t* full;              /* Slabs with no objects free */
+    slab_t* empty;             /* A slab with every object free, kept to avoid thrashing */
+    spinlock_t lock;           /* Lock protecting the slab lists and statistics */
+    struct kmem_cache* next_cache; /* Next cache in the statistics list */
+
+    /* Usage statistics */
+    uint32_t active_objects;   /* Objects handed out */
+    uint32_t total_objects;    /* Objects in every slab */
+    uint32_t num_slabs;        /* Slabs the cache has */
+    uint32_t num_allocs;       /* Successful allocations */
+    uint32_t num_frees;        /* Frees */
+    uint32_t failed_allocs;    /* Allocations that found no memory */
+} kmem_cache_t;
+
+/* Static initializer for a cache; its layout is worked out on first use */
+#define KMEM_CACHE(cache_name, object_bytes, object_align) {    \
+    .name = (const int8_t*)(cache_name),                        \
+    .object_size = (object_bytes),                              \
+    .align = (object_align),                                    \
+    .lock = SPINLOCK_UNLOCKED                                   \
+}
+
+/* Allocate an object from a cache; returns NULL if memory is full */
+extern void* kmem_cache_alloc(kmem_cache_t* cache);
+
+/* Give an object back to the cache it came from */
+extern void kmem_cache_free(kmem_cache_t* cache, void* object);
+
+/* Allocate size bytes from the smallest kmalloc cache that fits; returns NULL on failure */
+extern void* kmalloc(uint32_t size);
+
+/* Free memory from kmalloc (NULL is ignored) */
+extern void kfree(void* ptr);
+
+/* Print the usage statistics of every cache that has been used */
+extern void kmem_print_stats(void);
+
+#endif /* _SLAB_H */
@@ -0,0 +1,66 @@
+/* spinlock.h - Defines used for mutual exclusion between processors
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SPINLOCK_H
+#define _SPINLOCK_H
+
+#include "types.h"
+#include "lib.h"
+
+/* A lock that is busy-waited on; only ever held with interrupts disabled */
+typedef struct spinlock {
+    volatile uint32_t locked; /* Nonzero while some processor holds the lock */
+} spinlock_t;
+
+/* Initializer for a lock that nobody holds */
+#define SPINLOCK_UNLOCKED { 0 }
+
+/* Acquire the lock, spinning until it is free
+ * Interrupts must already be disabled on this processor */
+#define spin_lock(lock)                 \
+do {                                    \
+    asm volatile ("                   \n\
+            1:                        \n\
+            movl $1, %%eax            \n\
+            xchgl %%eax, %0           \n\
+            testl %%eax, %%eax        \n\
+            jz 3f                     \n\
+            2:                        \n\
+            pause                     \n\
+            cmpl $0, %0               \n\
+            jne 2b                    \n\
+            jmp 1b                    \n\
+            3:                        \n\
+            "                           \
+            : "+m"((lock)->locked)      \
+            :                           \
+            : "eax", "memory", "cc"     \
+    );                                  \
+} while (0)
+
+/* Release the lock, leaving interrupts as they are */
+#define spin_unlock(lock)               \
+do {                                    \
+    asm volatile ("movl $0, %0"         \
+            : "=m"((lock)->locked)      \
+            :                           \
+            : "memory"                  \
+    );                                  \
+} while (0)
+
+/* Save flags, disable interrupts on this processor and acquire the lock */
+#define spin_lock_irqsave(lock, flags)  \
+do {                                    \
+    cli_and_save(flags);                \
+    spin_lock(lock);                    \
+} while (0)
+
+/* Release the lock and restore the flags saved by spin_lock_irqsave */
+#define spin_unlock_irqrestore(lock, flags) \
+do {                                    \
+    spin_unlock(lock);                  \
+    restore_flags(flags);               \
+} while (0)
+
+#endif /* _SPINLOCK_H */
@@ -5,18 +5,31 @@
 #include "file_drivers.h"
 #include "terminal.h"
 #include "rtc_drivers.h"
+#include "pipe_drivers.h"
 #include "process.h"
 #include "lib.h"
 #include "scheduling.h"
 
 #include "paging.h"
+#include "clock.h"
+#include "fpu.h"
+#include "cpu.h"
+#include "shm.h"
 
-/* File operations for all the different kinds of file types */
-static int32_t std_in_fops[] = {(int32_t) terminal_open, (int32_t) terminal_read, NULL, (int32_t) terminal_close};
-static int32_t std_out_fops[] = {(int32_t) terminal_open, NULL, (int32_t) terminal_write, (int32_t) terminal_close};
-static int32_t file_fops[] = {(int32_t) open_file, (int32_t) read_file, (int32_t) write_file, (int32_t) close_file};
-static int32_t directory_fops[] = {(int32_t) open_directory, (int32_t) read_directory, (int32_t) write_directory, (int32_t) close_directory};
-static int32_t rtc_fops[] = {(int32_t) open_rtc, (int32_t) read_rtc, (int32_t) write_rtc, (int32_t) close_rtc};
+
+/* File operations for all the different kinds of file types (dup is NULL when a copied fd needs no work,
+ * readv/writev are NULL when the buffers are just read or written one at a time, and lseek/pread
+ * are NULL for files without positions) */
+static int32_t std_in_fops[] = {(int32_t) terminal_open, (int32_t) terminal_read, NULL, (int32_t) terminal_close, NULL, NULL, NULL, NULL, NULL};
+static int32_t std_out_fops[] = {(int32_t) terminal_open, NULL, (int32_t) terminal_write, (int32_t) terminal_close, NULL, NULL, (int32_t) terminal_writev, NULL, NULL};
+static int32_t file_fops[] = {(int32_t) open_file, (int32_t) read_file, (int32_t) write_file, (int32_t) close_file, NULL, (int32_t) readv_file, NULL, (int32_t) lseek_file, (int32_t) pread_file};
+static int32_t directory_fops[] = {(int32_t) open_directory, (int32_t) read_directory, (int32_t) write_directory, (int32_t) close_directory, NULL, NULL, NULL, NULL, NULL};
+static int32_t rtc_fops[] = {(int32_t) open_rtc, (int32_t) read_rtc, (int32_t) write_rtc, (int32_t) close_rtc, (int32_t) dup_rtc, NULL, NULL, NULL, NULL};
+static int32_t pipe_read_fops[] = {NULL, (int32_t) read_pipe, NULL, (int32_t) close_pipe_reader, (int32_t) dup_pipe_reader, NULL, NULL, NULL, NULL};
+static int32_t pipe_write_fops[] = {NULL, NULL, (int32_t) write_pipe, (int32_t) close_pipe_writer, (int32_t) dup_pipe_writer, NULL, NULL, NULL, NULL};
+
+static void close_fd(int32_t fd);
+static int32_t copy_iovecs(iovec_t* vec, const iovec_t* iov, int32_t iovcnt);
 
 /* sys_halt
  * Description: The halt system call terminates a proccess, returning the specified value to its
@@ -33,15 +46,13 @@ int32_t sys_halt(uint8_t status)
     pcb_t* pcb; /* Pointer to the current PCB */
     uint32_t i; /* Iteration variable (for closing FDs) */
     uint32_t retval;
-    uint32_t new_phys_addr;
-    uint32_t offset;
     
     
     /***   1. Close any relevant FDs ***/
-    /* Loop through FDs and close if in use */
-    for (i = FIRST_FD; i < FD_ARRAY_SIZE; i++)
+    /* Loop through FDs and close if in use (stdin and stdout too, since they may be pipes) */
+    for (i = 0; i < FD_ARRAY_SIZE; i++)
     {
-        sys_close(i);
+        close_fd(i);
     }
     
     
@@ -49,46 +60,60 @@ int32_t sys_halt(uint8_t status)
     /* Setting the current PCB */
     pcb = CURRENT_PCB_ADDRESS;
     
-    /* Restoring the process information */
-    REMOVE_PID(global_pid);
+    /* Nothing is waiting on a forked process, so it just goes away */
+    if (pcb->forked)
+    {
+        exit_process();
+    }
     
     /* Restarting shell if we try to quit out of a base shell */
     if (pcb->parent_pid == -1)
     {
         reset_screen();
-        sys_execute((uint8_t*)"shell");
+        exit_base_shell();
     }
     
-    /* Restoring the former ESP0 based on parent pid */
-    global_pid = pcb->parent_pid;
-    tss.esp0 = pcb->parent_esp0;
-    
-    
-    /***   3. Restore parent paging ***/
-    offset = global_pid;
-    new_phys_addr = (PID_OFFSET + offset) * FOUR_M;
-    page_modify(VIRTUAL_BEGIN, new_phys_addr, USER_PRIV);
+    /* Restoring the process information; the parent's pages are mapped back in
+     * first, since this process's pages are freed. The handover to the parent
+     * happens with interrupts off under sched_lock, so a preemption can't switch
+     * this process's pages back in under the parent. */
+    cli();
+    spin_lock(&sched_lock);
     
+    CURRENT_CPU->nr_processes--;
+    vm_switch(pcb->parent_pcb);
+    fpu_release(pcb);
     
-    /*** 3.5. Restore task's PCB ***/
-    CURRENT_TASK.pcb = pcb->parent_pcb;
-    CURRENT_TASK.pid = pcb->parent_pid;
+    /* Restoring the former ESP0 based on parent pid */
+    CURRENT_PID = pcb->parent_pid;
+    CURRENT_CPU->tss->esp0 = pcb->parent_esp0;
+    fpu_switch_to(pcb->parent_pcb);
+    clock_update(pcb->parent_pcb);
     
     
-    /***   4. Jump to execute return ***/
+    /***   3. Jump to execute return ***/
     /* Determining the proper return value based on status code */
     retval = (uint32_t) status;
     
-    /* Restoring parent's values of ESP and EBP and doing a hacky jump to parent */
-    asm volatile ("        \n\
-            movl %0, %%eax \n\
-            movl %1, %%esp \n\
-            movl %2, %%ebp \n\
-            leave          \n\
-            ret            \n\
+    /* Restoring parent's values of ESP and EBP and doing a hacky jump to parent.
+     * The process is only freed once we are on the parent's stack, since a fork
+     * or execute on another processor can take its PID (and kernel stack) as soon
+     * as it is. sched_lock is released and interrupts come back on first. */
+    asm volatile ("           \n\
+            movl %1, %%esp    \n\
+            movl %2, %%ebp    \n\
+            movl $0, %4       \n\
+            sti               \n\
+            pushl %0          \n\
+            pushl %3          \n\
+            call process_free \n\
+            addl $4, %%esp    \n\
+            popl %%eax        \n\
+            leave             \n\
+            ret               \n\
             "
             : 
-            : "r"(retval), "r"(pcb->parent_esp), "r"(pcb->parent_ebp)
+            : "r"(retval), "r"(pcb->parent_esp), "r"(pcb->parent_ebp), "r"(pcb), "m"(sched_lock.locked)
             : "esp", "ebp"
     );
     /* Return */
@@ -122,36 +147,41 @@ int32_t sys_execute(const uint8_t* command)
     uint32_t cmd_end_index;
     uint32_t arg_start_index;
     uint32_t arg_end_index;
-    uint32_t exec_fd;
-    uint32_t exec_header;
+    d_entry_t exec_dentry;
+    uint32_t i;
     pcb_t* pcb;
+    terminal_t* terminal; /* Terminal the new process runs on */
+    uint32_t priority;    /* Base priority the new process inherits */
     
     
     /***   0. See if process is available ***/
-    /* Assign the new pid to the first available one */
-    FIRST_AVAILABLE_PID(new_pid);
-    
-    /* Return if there's no more processes available */
-    if (!(~new_pid))
+    /* Allocate a PID and kernel stack; return if memory or PIDs have run out */
+    if (!(pcb = process_alloc()))
     {
         return -1;
     }
+    new_pid = pcb->pid;
     
-    /* Assign parent pid based on whether or not it's the one of the first processes */
-    if (new_pid < NUM_TERMINALS)
+    /* Base shells have no parent and run on the terminal they were started for */
+    if (CURRENT_CPU->shell_terminal)
     {
         parent_pid = -1;
+        terminal = CURRENT_CPU->shell_terminal;
+        priority = 0;
+        CURRENT_CPU->shell_terminal = NULL;
     }
     else
     {
-        parent_pid = global_pid;
+        parent_pid = CURRENT_PID;
+        terminal = CURRENT_PCB_ADDRESS->terminal;
+        priority = CURRENT_PCB_ADDRESS->base_priority;
     }
     
     /***   1. Parse args ***/
     /* Returning error if command is invalid or just a null character */
     if (!command || !(*command))
     {
-        REMOVE_PID(new_pid);
+        process_free(pcb);
         return -1;
     }
     
@@ -190,41 +220,41 @@ int32_t sys_execute(const uint8_t* command)
     }
     
     /***   2. Check file validity ***/
-    /* Checking if file exists */
-    if ((exec_fd = sys_open(parsed_cmd)) == -1)
+    /* Looking the file up once; only regular files can be executed */
+    if ((read_dentry_by_name(parsed_cmd, &exec_dentry) == -1) || (exec_dentry.filetype != FILETYPE_FILE))
     {
-        REMOVE_PID(new_pid);
+        process_free(pcb);
         return -1;
     }
     
-    /* Get file header */
-    read_file(exec_fd, (uint8_t*) &exec_header, sizeof(uint32_t));
-
-    /* Check to see if it matches the ELF header, if not return error */
-    if (exec_header != ELF_HEADER)
+    /***   3. Set up paging ***/
+    /* Base shells get the default limits; everything else keeps its parent's */
+    if (parent_pid == -1)
+    {
+        pcb->stack_limit = DEFAULT_STACK_LIMIT;
+        pcb->heap_limit = VIRTUAL_END - VIRTUAL_BEGIN;
+    }
+    else
+    {
+        pcb->stack_limit = CURRENT_PCB_ADDRESS->stack_limit;
+        pcb->heap_limit = CURRENT_PCB_ADDRESS->heap_limit;
+    }
+    
+    /* Mapping the ELF segments; this also checks the header, and gets the entry point */
+    if (vm_exec(pcb, exec_dentry.inode_number, &eip) == -1)
     {
-        REMOVE_PID(new_pid);
+        process_free(pcb);
         return -1;
     }
     
-    /***   3. Set up paging ***/
-    /* Change page directory to one with virtual address set for user program to use */
-    uint32_t new_phys_addr = (PID_OFFSET + new_pid) * FOUR_M;
-    page_modify(VIRTUAL_BEGIN, new_phys_addr, USER_PRIV);
-
     /***   4. Load file into memory ***/
-    /* Reading the file into memory, and then closing the file */
-    uint32_t length = file_size((uint8_t*)parsed_cmd);
-    read_data(CURRENT_PCB_ADDRESS->fd_array[exec_fd].inode, 0, (uint8_t*)PROGRAM_START_ADDRESS, length);
-    sys_close(exec_fd);
+    /* The file's pages are shared from its template; the heap and stack are faulted in
+     * as they're touched. They are switched to in step 6, along with the rest of the handover. */
     
     /***   5. Create PCB/Open FDs ***/
-    /* Calculating the relevant addresses */
-    pcb = PCB_ADDRESS(new_pid);
-    
     /* Assign the parent pid number in the PCB */
     pcb->parent_pid = parent_pid;
-    pcb->terminal = CURRENT_TASK.terminal;
+    pcb->terminal = terminal;
     pcb->parent_pcb = PCB_ADDRESS(parent_pid);
     strncpy((int8_t*) pcb->args, (int8_t*) parsed_arg, MAX_ARG_SIZE);
     
@@ -239,35 +269,81 @@ int32_t sys_execute(const uint8_t* command)
             : 
     );
     
-    /* Index 0 and 1 are stdin and stdout respectively */
-    pcb->fd_array[0].file_ops = std_in_fops;
-    pcb->fd_array[0].flags |= FD_IN_USE;
-    pcb->fd_array[1].file_ops = std_out_fops;
-    pcb->fd_array[1].flags |= FD_IN_USE;
+    /* No files are open yet (closing now calls into the driver, so stale flags matter) */
+    for (i = FIRST_FD; i < FD_ARRAY_SIZE; i++)
+    {
+        pcb->fd_array[i].flags = 0;
+    }
     
-    /* Assigning the kernel stack address to the TSS's ESP0 */
-    pcb->parent_esp0 = tss.esp0;
-    tss.esp0 = KERNEL_STACK_ADDRESS(new_pid);
+    /* Index 0 and 1 are stdin and stdout respectively; a child gets its parent's,
+     * which the shell may have pointed at pipes, and a base shell the terminal's */
+    if (parent_pid == -1)
+    {
+        pcb->fd_array[0].file_ops = std_in_fops;
+        pcb->fd_array[0].flags = FD_IN_USE;
+        pcb->fd_array[1].file_ops = std_out_fops;
+        pcb->fd_array[1].flags = FD_IN_USE;
+    }
+    else
+    {
+        for (i = 0; i < FIRST_FD; i++)
+        {
+            pcb->fd_array[i] = pcb->parent_pcb->fd_array[i];
+            if ((pcb->fd_array[i].flags & FD_IN_USE) && pcb->fd_array[i].file_ops[FOPS_DUP])
+            {
+                ((dup_t)(pcb->fd_array[i].file_ops[FOPS_DUP]))(i);
+            }
+        }
+    }
     
+    /*** 5.5. Populate scheduling info ***/
+    /* The child takes the parent's place on the processor; the parent stays off the run queue until it halts */
+    pcb->pid = new_pid;
+    pcb->forked = FALSE;
+    pcb->cpu = CURRENT_CPU->id;
+    pcb->state = TASK_RUNNABLE;
+    pcb->base_priority = priority;
+    pcb->priority = priority;
+    pcb->ticks_used = 0;
+    pcb->run_next = NULL;
+    pcb->wait_next = NULL;
     
-    /*** 5.5. Populate task structure ***/
-    CURRENT_TASK.pcb = pcb;
-    CURRENT_TASK.pid = new_pid;
+    pcb->fpu_used = FALSE;
     
     /***   6. Prepare for context switch ***/
     /* Assign/calculate the relevant values for the context switch */
-    eip = *((uint32_t*)(PROGRAM_START_ADDRESS + ENTRY_POINT_LOCATION));
     cs = USER_CS;
     eflags |= ENABLE_INTERRUPTS;
     esp = VIRTUAL_STACK_START;
     ss = USER_DS;
     
+    /* The scheduler maps the current process's pages in when it switches back to it,
+     * so the pages, ESP0 and current PID all change over under sched_lock. Interrupts
+     * stay off until the IRET, which turns them back on from the new EFLAGS. */
+    cli();
+    spin_lock(&sched_lock);
+    
+    CURRENT_CPU->nr_processes++;
+    vm_switch(pcb);
+    
+    /* A base shell's terminal isn't the one the idle task last left mapped */
+    if (parent_pid == -1)
+    {
+        terminal_map_vidmap(terminal);
+    }
+    
+    /* Assigning the kernel stack address to the TSS's ESP0 */
+    pcb->parent_esp0 = CURRENT_CPU->tss->esp0;
+    CURRENT_CPU->tss->esp0 = KERNEL_STACK_ADDRESS(new_pid);
+    
+    /* The parent's FPU state stays loaded until the child first uses the FPU */
+    fpu_switch_to(pcb);
+    clock_update(pcb);
+    
     /* Update to indicate that there's a new process running now */
-    global_pid = new_pid;
-
-    /* Initialize the pcb_started varfor use with the virtual RTC */
-
-    pcb_all_started = pit_interrupt_counter;
+    CURRENT_PID = new_pid;
+    
+    spin_unlock(&sched_lock);
     
     
     /*** 7/8. Push IRET context to stack and switch context ***/
@@ -280,6 +356,355 @@ int32_t sys_execute(const uint8_t* command)
     return -1;
 }
 
+/* sys_fork
+ * Description: Creates a copy of the current process that runs alongside it.
+ * The child gets a copy of the PCB and the open files, and shares the user
+ * pages copy-on-write, so nothing is copied until one of them writes. Both
+ * return from the call: the child with 0, the parent with the child's PID.
+ * Unlike sys_execute, the parent doesn't wait for the child to halt.
+ * Inputs: None
+ * Returns: The child's PID in the parent, 0 in the child, -1 on failure
+ */
+int32_t sys_fork(void)
+{
+    /* Local variables */
+    pcb_t* parent = CURRENT_PCB_ADDRESS; /* The process forking */
+    pcb_t* pcb;                          /* The child */
+    uint32_t pid;                        /* PID of the child */
+    uint32_t* frame;                     /* Child's copy of the system call frame */
+    uint32_t* switch_frame;              /* What the scheduler pops to first switch to the child */
+    uint32_t i;
+    
+    if (CURRENT_PID == IDLE_PID)
+    {
+        return -1;
+    }
+    
+    if (!(pcb = process_alloc()))
+    {
+        return -1;
+    }
+    pid = pcb->pid;
+    
+    /* The child starts as a copy of the parent, apart from its identity and pages */
+    memcpy(pcb, parent, sizeof(pcb_t));
+    pcb->pid = pid;
+    if (vm_fork(pcb, parent) == -1)
+    {
+        process_free(pcb);
+        return -1;
+    }
+    
+    pcb->forked = TRUE;
+    pcb->parent_pid = CURRENT_PID;
+    pcb->parent_pcb = parent;
+    pcb->priority = parent->base_priority;
+    pcb->run_next = NULL;
+    pcb->wait_next = NULL;
+    fpu_copy(pcb, parent);
+    
+    /* Open files are shared with the child */
+    for (i = 0; i < FD_ARRAY_SIZE; i++)
+    {
+        if ((parent->fd_array[i].flags & FD_IN_USE) && parent->fd_array[i].file_ops[FOPS_DUP])
+        {
+            ((dup_t)(parent->fd_array[i].file_ops[FOPS_DUP]))(i);
+        }
+    }
+    
+    /* The child returns to user space through a copy of this system call's frame, with 0 in EAX */
+    frame = (uint32_t*)(KERNEL_STACK_ADDRESS(pid) - SYSCALL_FRAME_SIZE);
+    memcpy(frame, (void*)(KERNEL_STACK_ADDRESS(parent->pid) - SYSCALL_FRAME_SIZE), SYSCALL_FRAME_SIZE);
+    frame[SYSCALL_FRAME_EAX] = 0;
+    
+    /* The scheduler switches in with leave and ret, which land in fork_return */
+    switch_frame = frame - 2;
+    switch_frame[0] = 0;
+    switch_frame[1] = (uint32_t) fork_return;
+    pcb->schedule_esp = (uint32_t) switch_frame;
+    pcb->schedule_ebp = (uint32_t) switch_frame;
+    pcb->schedule_esp0 = KERNEL_STACK_ADDRESS(pid);
+    
+    start_process(pcb);
+    
+    return pid;
+}
+
+/* sys_sbrk
+ * Description: Grows (or shrinks) the heap of the current process, like the
+ * UNIX sbrk call. The heap starts right after the program and can grow up to
+ * its limit, or the room kept for the stack. New pages are only given memory when they're first touched.
+ * Inputs: increment -- number of bytes to add to the heap; may be negative
+ * Returns: The old end of the heap (the start of the new memory), or -1 if
+ * the heap can't be moved that far
+ */
+int32_t sys_sbrk(int32_t increment)
+{
+    if (CURRENT_PID == IDLE_PID)
+    {
+        return -1;
+    }
+    
+    return vm_brk(CURRENT_PCB_ADDRESS, increment);
+}
+
+/* sys_setlimit
+ * Description: Sets how far the stack or the heap of the current process can
+ * grow. The stack grows down from the top of memory as it is touched, and the
+ * heap can't grow into the room kept for it. Programs the process executes
+ * start with the same limits.
+ * Inputs: resource -- LIMIT_STACK or LIMIT_HEAP
+ *         limit -- most bytes the stack or heap can grow to
+ * Returns: The old limit, or -1 if the limit is smaller than what is already
+ * in use, or the stack limit would reach into the heap
+ */
+int32_t sys_setlimit(int32_t resource, uint32_t limit)
+{
+    if (CURRENT_PID == IDLE_PID)
+    {
+        return -1;
+    }
+    
+    return vm_set_limit(CURRENT_PCB_ADDRESS, resource, limit);
+}
+
+/* sys_shm_create
+ * Description: Finds the shared memory segment with a key, creating it if
+ * there's none. Processes that agree on a key (or a parent and the children
+ * it forks) can all map the segment with sys_shm_map. A segment nobody maps
+ * is freed when the process that created it halts, and the IDs other
+ * processes found it by stop working.
+ * Inputs: key -- key for the segment
+ *         size -- number of bytes the segment needs (up to 64KB)
+ * Returns: The ID of the segment, or -1 if it can't be made
+ */
+int32_t sys_shm_create(uint32_t key, uint32_t size)
+{
+    if (CURRENT_PID == IDLE_PID)
+    {
+        return -1;
+    }
+    
+    return shm_create(key, size, CURRENT_PCB_ADDRESS);
+}
+
+/* sys_shm_map
+ * Description: Maps a shared memory segment into the current process. Writes
+ * through the mapping are seen by every other process that has it mapped.
+ * Inputs: id -- ID from sys_shm_create
+ *         address -- page aligned address in user memory, clear of the program,
+ *                    the heap and the stack
+ * Returns: -1 for invalid parameters; 0 on success
+ */
+int32_t sys_shm_map(int32_t id, void* address)
+{
+    if (CURRENT_PID == IDLE_PID)
+    {
+        return -1;
+    }
+    
+    return shm_map(CURRENT_PCB_ADDRESS, id, (uint32_t)address);
+}
+
+/* sys_shm_unmap
+ * Description: Unmaps a shared memory segment from the current process. The
+ * segment is freed once no process has it mapped; halting unmaps everything.
+ * Inputs: address -- address the segment was mapped at
+ * Returns: -1 if no segment is mapped there; 0 on success
+ */
+int32_t sys_shm_unmap(void* address)
+{
+    if (CURRENT_PID == IDLE_PID)
+    {
+        return -1;
+    }
+    
+    return shm_unmap(CURRENT_PCB_ADDRESS, (uint32_t)address);
+}
+
+/* sys_pipe
+ * Description: Creates a pipe, a buffer in the kernel that bytes written to one
+ * fd can be read back from another. Reads block until there is data and return
+ * 0 once every write end is closed; writes block while the pipe is full. Both
+ * ends are shared by fork and by sys_dup2, and a child started with sys_execute
+ * gets its parent's stdin and stdout, so a shell can connect programs with them.
+ * Inputs: fds -- array of two ints in user memory for the new fds
+ * Outputs: fds[0] is set to the read end and fds[1] to the write end
+ * Returns: -1 for invalid parameters or if fds or memory run out; 0 on success
+ */
+int32_t sys_pipe(int32_t* fds)
+{
+    /* Local variables */
+    pcb_t* pcb = CURRENT_PCB_ADDRESS;
+    int32_t pipe;          /* Pointer to the new pipe */
+    int32_t read_fd = -1;  /* FD for the read end */
+    int32_t write_fd = -1; /* FD for the write end */
+    int32_t i;
+    
+    //check that pointer address is in user memory
+    if ( ((uint32_t)fds < VIRTUAL_BEGIN) || ((uint32_t)fds > VIRTUAL_END - 2 * sizeof(int32_t)) )
+    {
+        return -1;
+    }
+    
+    for (i = FIRST_FD; (i < FD_ARRAY_SIZE) && (write_fd == -1); i++)
+    {
+        if (!(pcb->fd_array[i].flags & FD_IN_USE))
+        {
+            if (read_fd == -1)
+            {
+                read_fd = i;
+            }
+            else
+            {
+                write_fd = i;
+            }
+        }
+    }
+    
+    if ((write_fd == -1) || ((pipe = open_pipe()) == -1))
+    {
+        return -1;
+    }
+    
+    pcb->fd_array[read_fd].file_ops = pipe_read_fops;
+    pcb->fd_array[read_fd].inode = pipe;
+    pcb->fd_array[read_fd].position = 0;
+    pcb->fd_array[read_fd].flags = FD_IN_USE;
+    pcb->fd_array[write_fd].file_ops = pipe_write_fops;
+    pcb->fd_array[write_fd].inode = pipe;
+    pcb->fd_array[write_fd].position = 0;
+    pcb->fd_array[write_fd].flags = FD_IN_USE;
+    
+    fds[0] = read_fd;
+    fds[1] = write_fd;
+    return 0;
+}
+
+/* sys_dup2
+ * Description: Makes new_fd refer to the same file as old_fd, closing whatever
+ * new_fd had open first. Either can be stdin or stdout, which is how a
+ * program's input or output is pointed at a pipe before it is executed.
+ * Inputs: old_fd -- an open fd
+ *         new_fd -- the fd to replace
+ * Returns: new_fd, or -1 for invalid parameters
+ */
+int32_t sys_dup2(int32_t old_fd, int32_t new_fd)
+{
+    /* Local variables */
+    pcb_t* pcb = CURRENT_PCB_ADDRESS;
+    
+    if ((old_fd < 0) || (old_fd > FD_ARRAY_SIZE - 1) || (new_fd < 0) || (new_fd > FD_ARRAY_SIZE - 1))
+    {
+        return -1;
+    }
+    
+    if (!(pcb->fd_array[old_fd].flags & FD_IN_USE))
+    {
+        return -1;
+    }
+    
+    if (old_fd == new_fd)
+    {
+        return new_fd;
+    }
+    
+    close_fd(new_fd);
+    pcb->fd_array[new_fd] = pcb->fd_array[old_fd];
+    if (pcb->fd_array[old_fd].file_ops[FOPS_DUP])
+    {
+        ((dup_t)(pcb->fd_array[old_fd].file_ops[FOPS_DUP]))(old_fd);
+    }
+    
+    return new_fd;
+}
+
+/* sys_io_submit
+ * Description: Carries out the reads, writes, opens and closes a process has
+ * queued on an I/O ring, in order, and posts the result of each to the ring's
+ * completion queue, so a whole batch of them costs one system call. Stops
+ * early if the completion queue fills up; the rest stay queued. Each operation
+ * goes through the same system call as it would on its own, which checks its
+ * buffer like any other.
+ * Inputs: ring -- the process's I/O ring
+ * Returns: The number of operations carried out, or -1 if the ring is invalid
+ */
+int32_t sys_io_submit(io_ring_t* ring)
+{
+    /* Local variables */
+    io_sqe_t* sqes;    /* Submission queue */
+    io_cqe_t* cqes;    /* Completion queue */
+    io_sqe_t sqe;      /* Copy of the operation being carried out */
+    uint32_t mask;     /* Mask that wraps a head or tail around the queues */
+    uint32_t sq_tail;  /* End of the operations queued when the call was made */
+    int32_t result;    /* Result of the operation */
+    int32_t done = 0;  /* Number of operations carried out */
+    
+    //check that the ring and both queues are in user memory
+    if ( ((uint32_t)ring < VIRTUAL_BEGIN) || ((uint32_t)ring > VIRTUAL_END - sizeof(io_ring_t)) )
+    {
+        return -1;
+    }
+    mask = ring->entries - 1;
+    sqes = ring->sqes;
+    cqes = ring->cqes;
+    if (!ring->entries || (ring->entries & mask) || (ring->entries > (VIRTUAL_END - VIRTUAL_BEGIN) / sizeof(io_sqe_t)) ||
+            ((uint32_t)sqes < VIRTUAL_BEGIN) || ((uint32_t)sqes > VIRTUAL_END - ring->entries * sizeof(io_sqe_t)) ||
+            ((uint32_t)cqes < VIRTUAL_BEGIN) || ((uint32_t)cqes > VIRTUAL_END - ring->entries * sizeof(io_cqe_t)))
+    {
+        return -1;
+    }
+    
+    sq_tail = ring->sq_tail;
+    while ((ring->sq_head != sq_tail) && (ring->cq_tail - ring->cq_head < ring->entries))
+    {
+        sqe = sqes[ring->sq_head & mask];
+        switch (sqe.op)
+        {
+            case IO_OP_READ:
+                result = sys_read(sqe.fd, sqe.buf, sqe.nbytes);
+                break;
+            case IO_OP_WRITE:
+                result = sys_write(sqe.fd, sqe.buf, sqe.nbytes);
+                break;
+            case IO_OP_OPEN:
+                result = sys_open((const uint8_t*)sqe.buf);
+                break;
+            case IO_OP_CLOSE:
+                result = sys_close(sqe.fd);
+                break;
+            default:
+                result = -1;
+                break;
+        }
+        
+        cqes[ring->cq_tail & mask].result = result;
+        cqes[ring->cq_tail & mask].user_data = sqe.user_data;
+        ring->cq_tail++;
+        ring->sq_head++;
+        done++;
+    }
+    
+    return done;
+}
+
+/* start_base_shell
+ * Description: Executes a shell that has no parent on the given terminal. Used
+ * by the scheduler to give every terminal a shell and by sys_halt to restart one.
+ * Inputs: terminal -- the terminal the shell runs on
+ * Returns: -1 if the shell could not be executed; otherwise does not return
+ */
+int32_t start_base_shell(terminal_t* terminal)
+{
+    /* Each processor's idle task starts its own shells, so this is kept per processor */
+    CURRENT_CPU->shell_terminal = terminal;
+    sys_execute((uint8_t*)"shell");
+    
+    /* Only reached on failure; don't let the next execute think it's a base shell */
+    CURRENT_CPU->shell_terminal = NULL;
+    return -1;
+}
+
 /* sys_read
  * Description: Links the read syscall with the fd array fops pointer of
  * the current process. 
@@ -290,22 +715,24 @@ int32_t sys_execute(const uint8_t* command)
 int32_t sys_read(int32_t fd, void* buf, int32_t nbytes)
 {
     //bounds check
-    if (fd != 0 && (fd < FIRST_FD || fd > FD_ARRAY_SIZE -1))
+    if (fd < 0 || fd > FD_ARRAY_SIZE -1)
     {
         return -1;
     }
 
-    if (nbytes < 0)
+    //the whole buffer must be in user memory
+    if (vm_user_range(buf, nbytes) == -1)
     {
         return -1;
     }
-
-    if (!buf)
+    
+    if (!((CURRENT_PCB_ADDRESS)->fd_array[fd].flags & FD_IN_USE))
     {
         return -1;
     }
-    
-    if (!((CURRENT_PCB_ADDRESS)->fd_array[fd].flags & FD_IN_USE))
+
+    //stdout and the write end of a pipe can't be read
+    if (!(CURRENT_PCB_ADDRESS)->fd_array[fd].file_ops[FOPS_READ])
     {
         return -1;
     }
@@ -314,6 +741,52 @@ int32_t sys_read(int32_t fd, void* buf, int32_t nbytes)
     return ((read_t)((CURRENT_PCB_ADDRESS)->fd_array[fd].file_ops[FOPS_READ]))(fd, buf, nbytes);
 }
 
+/* sys_readv
+ * Description: Reads into several buffers in turn, like the UNIX readv
+ * call. Files read them all in one pass; other kinds of files read each
+ * buffer with their read operation, stopping at the first short read.
+ * Inputs: fd -- the file descriptor
+ *         iov -- the buffers (up to MAX_IOV of them)
+ *         iovcnt -- the number of buffers
+ * Returns: The number of bytes read, or -1 on failure
+ */
+int32_t sys_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+{
+    /* Local variables */
+    pcb_t* pcb = CURRENT_PCB_ADDRESS;
+    iovec_t vec[MAX_IOV]; /* Copy of the buffers */
+    int32_t total = 0;    /* Number of bytes read */
+    int32_t count;        /* Number of bytes read into one buffer */
+    int32_t i;
+    
+    if ((fd < 0) || (fd >= FD_ARRAY_SIZE) || !(pcb->fd_array[fd].flags & FD_IN_USE) ||
+            !pcb->fd_array[fd].file_ops[FOPS_READ] || (copy_iovecs(vec, iov, iovcnt) == -1))
+    {
+        return -1;
+    }
+    
+    if (pcb->fd_array[fd].file_ops[FOPS_READV])
+    {
+        return ((readv_t)(pcb->fd_array[fd].file_ops[FOPS_READV]))(fd, vec, iovcnt);
+    }
+    
+    for (i = 0; i < iovcnt; i++)
+    {
+        count = ((read_t)(pcb->fd_array[fd].file_ops[FOPS_READ]))(fd, vec[i].base, vec[i].len);
+        if (count == -1)
+        {
+            return total ? total : -1;
+        }
+        total += count;
+        if (count < vec[i].len)
+        {
+            break;
+        }
+    }
+    
+    return total;
+}
+
 /* sys_write
  * Description: Links the write syscall with the fd array fops pointer of
  * the current process. 
@@ -324,7 +797,7 @@ int32_t sys_read(int32_t fd, void* buf, int32_t nbytes)
  */
 int32_t sys_write(int32_t fd, const void* buf, int32_t nbytes)
 {
-    if (fd != 1 && (fd < FIRST_FD || fd > FD_ARRAY_SIZE -1))
+    if (fd < 0 || fd > FD_ARRAY_SIZE -1)
     {
         return -1;
     }
@@ -339,14 +812,125 @@ int32_t sys_write(int32_t fd, const void* buf, int32_t nbytes)
         return 0;
     }
     
+    //the whole buffer must be in user memory
+    if (vm_user_range(buf, nbytes) == -1)
+    {
+        return -1;
+    }
+    
     if (!((CURRENT_PCB_ADDRESS)->fd_array[fd].flags & FD_IN_USE))
     {
         return -1;
     }
 
+    //stdin and the read end of a pipe can't be written
+    if (!(CURRENT_PCB_ADDRESS)->fd_array[fd].file_ops[FOPS_WRITE])
+    {
+        return -1;
+    }
+
     return ((write_t)((CURRENT_PCB_ADDRESS)->fd_array[fd].file_ops[FOPS_WRITE]))(fd, buf, nbytes);
 }
 
+/* sys_lseek
+ * Description: Moves the position a file is read from, like the UNIX lseek
+ * call, so it can be read from any offset without reopening it. Only regular
+ * files have a position that can be moved.
+ * Inputs: fd -- the file descriptor
+ *         offset -- bytes to move, from where whence says
+ *         whence -- SEEK_SET, SEEK_CUR or SEEK_END
+ * Returns: The new position, or -1 if the file can't seek or the position
+ * would be negative
+ */
+int32_t sys_lseek(int32_t fd, int32_t offset, int32_t whence)
+{
+    /* Local variables */
+    pcb_t* pcb = CURRENT_PCB_ADDRESS;
+    
+    if ((fd < 0) || (fd >= FD_ARRAY_SIZE) || !(pcb->fd_array[fd].flags & FD_IN_USE) ||
+            !pcb->fd_array[fd].file_ops[FOPS_LSEEK])
+    {
+        return -1;
+    }
+    
+    return ((lseek_t)(pcb->fd_array[fd].file_ops[FOPS_LSEEK]))(fd, offset, whence);
+}
+
+/* sys_pread
+ * Description: Reads from a given offset of a file without moving its
+ * position, like the UNIX pread call. Only regular files can be read this way.
+ * Inputs: fd -- the file descriptor
+ *         buf -- the buffer to read into
+ *         nbytes -- the number of bytes to read
+ *         offset -- where in the file to start (passed in EDI)
+ * Returns: The number of bytes read (0 past the end of the file), or -1 on failure
+ */
+int32_t sys_pread(int32_t fd, void* buf, int32_t nbytes, int32_t offset)
+{
+    /* Local variables */
+    pcb_t* pcb = CURRENT_PCB_ADDRESS;
+    
+    if ((fd < 0) || (fd >= FD_ARRAY_SIZE) || !(pcb->fd_array[fd].flags & FD_IN_USE) ||
+            !pcb->fd_array[fd].file_ops[FOPS_PREAD] || (offset < 0))
+    {
+        return -1;
+    }
+    
+    //the whole buffer must be in user memory
+    if (vm_user_range(buf, nbytes) == -1)
+    {
+        return -1;
+    }
+    
+    return ((pread_t)(pcb->fd_array[fd].file_ops[FOPS_PREAD]))(fd, buf, nbytes, offset);
+}
+
+/* sys_writev
+ * Description: Writes several buffers in turn, like the UNIX writev call.
+ * The terminal prints them as one span; other kinds of files write each
+ * buffer with their write operation, stopping at the first short write.
+ * Inputs: fd -- the file descriptor
+ *         iov -- the buffers (up to MAX_IOV of them)
+ *         iovcnt -- the number of buffers
+ * Returns: The number of bytes written, or -1 on failure
+ */
+int32_t sys_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+{
+    /* Local variables */
+    pcb_t* pcb = CURRENT_PCB_ADDRESS;
+    iovec_t vec[MAX_IOV]; /* Copy of the buffers */
+    int32_t total = 0;    /* Number of bytes written */
+    int32_t count;        /* Number of bytes written from one buffer */
+    int32_t i;
+    
+    if ((fd < 0) || (fd >= FD_ARRAY_SIZE) || !(pcb->fd_array[fd].flags & FD_IN_USE) ||
+            !pcb->fd_array[fd].file_ops[FOPS_WRITE] || (copy_iovecs(vec, iov, iovcnt) == -1))
+    {
+        return -1;
+    }
+    
+    if (pcb->fd_array[fd].file_ops[FOPS_WRITEV])
+    {
+        return ((writev_t)(pcb->fd_array[fd].file_ops[FOPS_WRITEV]))(fd, vec, iovcnt);
+    }
+    
+    for (i = 0; i < iovcnt; i++)
+    {
+        count = ((write_t)(pcb->fd_array[fd].file_ops[FOPS_WRITE]))(fd, vec[i].base, vec[i].len);
+        if (count == -1)
+        {
+            return total ? total : -1;
+        }
+        total += count;
+        if (count < vec[i].len)
+        {
+            break;
+        }
+    }
+    
+    return total;
+}
+
 /* sys_open
  * Description: The open system call provides access to the filesystem. 
  * The call should find the directory entry corresponding to the
@@ -380,7 +964,12 @@ int32_t sys_open(const uint8_t* filename)
             switch(filetype)
             {
                 case FILETYPE_RTC: 
-                    open_rtc(filename);
+                    /* The inode holds a pointer to the file's virtual RTC */
+                    if ((CURRENT_PCB_ADDRESS->fd_array[i].inode = open_rtc(filename)) == -1)
+                    {
+                        (CURRENT_PCB_ADDRESS)->fd_array[i].flags &= ~FD_IN_USE;
+                        return -1;
+                    }
                     CURRENT_PCB_ADDRESS->fd_array[i].file_ops = rtc_fops;
                     break;
                 case FILETYPE_DIRECTORY: 
@@ -425,10 +1014,29 @@ int32_t sys_close(int32_t fd)
         return -1;
     }
 
-    (CURRENT_PCB_ADDRESS)->fd_array[fd].flags &= ~FD_IN_USE;
+    close_fd(fd);
     return 0;
 }
 
+/* close_fd
+ * Description: Closes an fd of the current process if it's open, including
+ * stdin and stdout (for sys_halt and sys_dup2).
+ * Input: The file descriptor to close.
+ * Returns: None
+ */
+static void close_fd(int32_t fd)
+{
+    if (!((CURRENT_PCB_ADDRESS)->fd_array[fd].flags & FD_IN_USE))
+    {
+        return;
+    }
+
+    // Let the driver release anything it allocated on open
+    ((close_t)((CURRENT_PCB_ADDRESS)->fd_array[fd].file_ops[FOPS_CLOSE]))(fd);
+
+    (CURRENT_PCB_ADDRESS)->fd_array[fd].flags &= ~FD_IN_USE;
+}
+
 /* sys_getargs
  * Description: Transfers the arguments that were populated into the current
  * process during execute into the passed in buffer.
@@ -509,4 +1117,54 @@ int32_t sys_sigreturn(void)
     return -1;
 }
 
+/* sys_nice
+ * Description: Changes the scheduling priority of the current process, like
+ * the UNIX nice call. Higher values are lower priority, but get longer slices
+ * of the processor when they do run. Children inherit the priority.
+ * Inputs: increment -- amount to add to the priority; may be negative
+ * Returns: The new priority (0 to NUM_PRIORITIES - 1)
+ */
+int32_t sys_nice(int32_t increment)
+{
+    return set_base_priority(increment);
+}
 
+/* copy_iovecs
+ * Description: Copies the buffers of a readv or writev into the kernel,
+ * checking that the array and every buffer are in user memory and the
+ * buffers add up to something a read or write can return.
+ * Inputs: vec -- where the copy goes (MAX_IOV entries)
+ *         iov -- the process's buffers
+ *         iovcnt -- the number of buffers
+ * Returns: 0 on success, -1 if the buffers are invalid
+ */
+static int32_t copy_iovecs(iovec_t* vec, const iovec_t* iov, int32_t iovcnt)
+{
+    /* Local variables */
+    uint32_t total = 0; /* Bytes in all the buffers */
+    int32_t i;
+    
+    //check that the array is in user memory
+    if ((iovcnt < 0) || (iovcnt > MAX_IOV) || ((uint32_t)iov < VIRTUAL_BEGIN) ||
+            ((uint32_t)iov > VIRTUAL_END - iovcnt * sizeof(iovec_t)))
+    {
+        return -1;
+    }
+    
+    memcpy(vec, iov, iovcnt * sizeof(iovec_t));
+    for (i = 0; i < iovcnt; i++)
+    {
+        //every buffer must lie entirely in user memory
+        if (vm_user_range(vec[i].base, vec[i].len) == -1)
+        {
+            return -1;
+        }
+        total += vec[i].len;
+        if (total > MAX_IOV_BYTES)
+        {
+            return -1;
+        }
+    }
+    
+    return 0;
+}
@@ -5,6 +5,7 @@
 #define _SYS_CALL_H
 
 #include "lib.h"
+#include "terminal.h"
 
 /* Header value for determining if a file is executable */
 #define ELF_HEADER 0x464C457F
@@ -24,14 +25,55 @@
 /* The start of the virtual address space for user programs (128MB) */
 #define PROGRAM_PAGE_START 0x08000000
 
-/* Virtual address for where the executable program should be loaded */
-#define PROGRAM_START_ADDRESS 0x08048000
-
-/* Index into the file for where the entry point is located */
-#define ENTRY_POINT_LOCATION 24
-
 /* Starting address of the virtual user stack */
-#define VIRTUAL_STACK_START 0x83FFFFC
+#define VIRTUAL_STACK_START (VIRTUAL_END - 4)
+
+/* Size of what a system call leaves on the kernel stack: EFLAGS, PUSHAL and the IRET frame */
+#define SYSCALL_FRAME_SIZE 0x38
+
+/* Index of the saved EAX (the return value) in that frame, counting 4 byte words from its bottom */
+#define SYSCALL_FRAME_EAX 0x08
+
+/* Operations that can be queued on an I/O ring */
+#define IO_OP_READ  0
+#define IO_OP_WRITE 1
+#define IO_OP_OPEN  2
+#define IO_OP_CLOSE 3
+
+/* A queued operation; buf is the filename for IO_OP_OPEN */
+typedef struct io_sqe {
+    int32_t op;         /* IO_OP_* */
+    int32_t fd;         /* File the operation is on (unused by IO_OP_OPEN) */
+    void* buf;          /* Buffer to read into or write from */
+    int32_t nbytes;     /* Bytes to read or write */
+    uint32_t user_data; /* Copied into the completion, for the process to match them up */
+} io_sqe_t;
+
+/* The result of a queued operation */
+typedef struct io_cqe {
+    int32_t result;     /* What the system call for the operation would have returned */
+    uint32_t user_data; /* user_data of the operation */
+} io_cqe_t;
+
+/* Submission and completion queues in a process's memory, which sys_io_submit
+ * works through. The heads and tails only ever count up, and wrap around the
+ * queues with a mask, so each queue is full when tail - head == entries.
+ *
+ * The kernel reaches user memory through the process's own page tables, so the
+ * rings are shared simply by living in the process; nothing separate is mapped
+ * in for them. There is also no polling mode that drains them from the PIT
+ * tick. Reads of the terminal, pipes and the RTC sleep, and there are no kernel
+ * threads to sleep in, so the operations only run from sys_io_submit, on the
+ * process's own kernel stack. */
+typedef struct io_ring {
+    uint32_t entries;   /* Slots in each queue (a power of two) */
+    uint32_t sq_head;   /* Next operation the kernel takes */
+    uint32_t sq_tail;   /* Where the process queues its next operation */
+    uint32_t cq_head;   /* Next completion the process takes */
+    uint32_t cq_tail;   /* Where the kernel posts its next completion */
+    io_sqe_t* sqes;     /* Submission queue */
+    io_cqe_t* cqes;     /* Completion queue */
+} io_ring_t;
 
 /* Identifiers for determining file type */
 #define FILETYPE_RTC 0
@@ -44,6 +86,44 @@ extern int32_t sys_halt(uint8_t status);
 /* Attempts to load an execute a program */
 extern int32_t sys_execute(const uint8_t* command);
 
+/* Creates a copy of the current process that shares its pages copy-on-write */
+extern int32_t sys_fork(void);
+
+/* Grows the heap of the current process; returns the old end of the heap */
+extern int32_t sys_sbrk(int32_t increment);
+
+/* Shared memory segments: create (or find) one by key, and map it in and out */
+extern int32_t sys_shm_create(uint32_t key, uint32_t size);
+extern int32_t sys_shm_map(int32_t id, void* address);
+extern int32_t sys_shm_unmap(void* address);
+
+/* Creates a pipe, putting the fds of its read and write ends in fds[0] and fds[1] */
+extern int32_t sys_pipe(int32_t* fds);
+
+/* Makes new_fd a copy of old_fd */
+extern int32_t sys_dup2(int32_t old_fd, int32_t new_fd);
+
+/* Read into or write from several buffers in one call */
+struct iovec;
+extern int32_t sys_readv(int32_t fd, const struct iovec* iov, int32_t iovcnt);
+extern int32_t sys_writev(int32_t fd, const struct iovec* iov, int32_t iovcnt);
+
+/* Move the position of a file, and read from an offset without moving it */
+extern int32_t sys_lseek(int32_t fd, int32_t offset, int32_t whence);
+extern int32_t sys_pread(int32_t fd, void* buf, int32_t nbytes, int32_t offset);
+
+/* Carries out the operations queued on an I/O ring, posting their completions */
+extern int32_t sys_io_submit(io_ring_t* ring);
+
+/* Sets how far the stack or heap of the current process can grow */
+extern int32_t sys_setlimit(int32_t resource, uint32_t limit);
+
+/* Where a forked process starts: returns to user space through its copy of the fork frame */
+extern void fork_return(void);
+
+/* Executes a shell with no parent on the given terminal */
+extern int32_t start_base_shell(terminal_t* terminal);
+
 /* Links the read syscall with the fd array fops pointer of the current process */
 extern int32_t sys_read(int32_t fd, void* buf, int32_t nbytes);
 
@@ -66,6 +146,9 @@ extern int32_t sys_vidmap(uint8_t** screen_start);
 extern int32_t sys_set_handler(int32_t signum, void* handler_address);
 extern int32_t sys_sigreturn(void);
 
+/* Changes the scheduling priority of the current process */
+extern int32_t sys_nice(int32_t increment);
+
 /* "Dummy" function for building up an IRET stack for context switching */
 extern void context_switch(uint32_t eip, uint32_t cs, uint32_t eflags, uint32_t esp, uint32_t ss);
 
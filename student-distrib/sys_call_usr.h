@@ -12,3 +12,17 @@ extern int32_t sys_getargs_usr(uint8_t buf, int32_t nbytes);
 extern int32_t sys_vidmap_usr(uint8_t** screen_start);
 extern int32_t sys_set_handler_usr(int32_t signum, void* handler_address);
 extern int32_t sys_sigreturn_usr(void);
+extern int32_t sys_nice_usr(int32_t increment);
+extern int32_t sys_fork_usr(void);
+extern int32_t sys_sbrk_usr(int32_t increment);
+extern int32_t sys_shm_create_usr(uint32_t key, uint32_t size);
+extern int32_t sys_shm_map_usr(int32_t id, void* address);
+extern int32_t sys_shm_unmap_usr(void* address);
+extern int32_t sys_pipe_usr(int32_t* fds);
+extern int32_t sys_dup2_usr(int32_t old_fd, int32_t new_fd);
+extern int32_t sys_setlimit_usr(int32_t resource, uint32_t limit);
+extern int32_t sys_io_submit_usr(struct io_ring* ring);
+extern int32_t sys_readv_usr(int32_t fd, const struct iovec* iov, int32_t iovcnt);
+extern int32_t sys_writev_usr(int32_t fd, const struct iovec* iov, int32_t iovcnt);
+extern int32_t sys_lseek_usr(int32_t fd, int32_t offset, int32_t whence);
+extern int32_t sys_pread_usr(int32_t fd, void* buf, int32_t nbytes, int32_t offset);
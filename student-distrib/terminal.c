@@ -11,8 +11,16 @@
 #include "scheduling.h"
 #include "process.h"
 #include "paging.h"
+#include "frame.h"
+#include "spinlock.h"
+#include "handlers.h"
+#include "apic.h"
+#include "cpu.h"
 /* File specific variables */
 
+/* Lock protecting the terminals, their input buffers and the screen */
+static spinlock_t terminal_lock = SPINLOCK_UNLOCKED;
+
 /* The input buffer (duh) */
 static uint8_t input_buffer[INPUT_BUFFER_SIZE];
 /* Current index into the buffer */
@@ -21,10 +29,11 @@ static uint8_t buffer_index;
 /* Flag for determining whether or not there is current input being collected */
 static volatile uint8_t input_status;
 
-/* File specific functions - see headers */
+/* File specific functions - see headers (all are called with terminal_lock held) */
 static void alt_f1(void);
 static void alt_f2(void);
 static void alt_f3(void);
+static void alt_f4(void);
 static void ctrl_c(void);
 static void ctrl_l(void);
 static void reset_buffer(void);
@@ -45,7 +54,7 @@ int32_t terminal_open(const uint8_t* filename)
     uint32_t flags;
     
     /* Start critical section */
-    cli_and_save(flags);
+    spin_lock_irqsave(&terminal_lock, flags);
     
     /* Initialize the keyboard */
     keyboard_init();
@@ -64,10 +73,18 @@ int32_t terminal_open(const uint8_t* filename)
         terminals[i].screen_y = 0;
         terminals[i].buffer_index = 0;
         terminals[i].input_status = INPUT_ENDED;
+        init_wait_queue(&(terminals[i].input_queue));
         terminals[i].terminal_number = i;
         terminals[i].active = !i;
         terminals[i].video_mem = (uint8_t*)(BASE_VIDEO_MEM + (i + 1) * FOUR_K);
-        map_virt_to_phys(terminals[i].video_mem, terminals[i].video_mem);
+        
+        /* Take a backing page from the frame allocator, falling back on the spare VGA page */
+        if (!terminals[i].video_backing && !(terminals[i].video_backing = frame_alloc(FRAME_ORDER_4K)))
+        {
+            terminals[i].video_backing = (uint32_t)terminals[i].video_mem;
+        }
+        map_virt_to_phys(terminals[i].video_mem, (uint8_t*)terminals[i].video_backing);
+        memset(terminals[i].video_mem, 0, FOUR_K);
         memset(terminals[i].input_buffer, NEWLINE, INPUT_BUFFER_SIZE);
     }
     memset(input_buffer, NEWLINE, INPUT_BUFFER_SIZE);
@@ -77,10 +94,7 @@ int32_t terminal_open(const uint8_t* filename)
     map_virt_to_phys((uint8_t*) BASE_VIDEO_MEM, (uint8_t*) BASE_VIDEO_MEM);
     map_virt_to_phys(ACTIVE_TERMINAL.video_mem, (uint8_t*) BASE_VIDEO_MEM);
     
-    /* Reset screen coords */
-    set_video_params(0, 0);
-    
-    restore_flags(flags);
+    spin_unlock_irqrestore(&terminal_lock, flags);
     
     /* Return success */
     return 0;
@@ -101,6 +115,8 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes)
     int32_t num_copied; /* Number of bytes copied */
     uint8_t* char_buf;  /* Casted version of buffer arg */
     terminal_t* current_terminal;
+    uint8_t line[INPUT_BUFFER_SIZE]; /* Copy of the input, taken while the lock is held */
+    uint32_t flags;     /* Save variable for flags */
     
     /* Checking valid parameters */
     if (!buf)
@@ -118,11 +134,17 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes)
     
     current_terminal = CURRENT_PCB_ADDRESS->terminal;
     
+    /* Start critical section so the newline can't slip in before we sleep */
+    spin_lock_irqsave(&terminal_lock, flags);
+    
     /* Signal that input is occurring atm */
     current_terminal->input_status = IN_PROGRESS;
     
-    /* Spin until input is over */
-    while (current_terminal->input_status);
+    /* Sleep until input is over */
+    while (current_terminal->input_status)
+    {
+        sleep_on_locked(&(current_terminal->input_queue), &terminal_lock);
+    }
     
     /* Determine how many bytes to copy based on index and requested number */
     if (current_terminal->buffer_index < nbytes)
@@ -134,10 +156,16 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes)
         num_copied = nbytes;
     }
     
-    /* Copy input buffer into the arg buffer and reset input */
-    memcpy(char_buf, current_terminal->input_buffer, num_copied);
+    /* Take the input and reset it */
+    memcpy(line, current_terminal->input_buffer, num_copied);
     reset_buffer();
     
+    /* End critical section */
+    spin_unlock_irqrestore(&terminal_lock, flags);
+    
+    /* Copy into the arg buffer outside the lock, so a bad pointer can't fault while it's held */
+    memcpy(char_buf, line, num_copied);
+    
     /* Return the number of bytes copied */
     return num_copied;
 }
@@ -155,9 +183,7 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes)
 int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes)
 {
     /* Local variables */
-    int i;               /* Iteration variable */
-    uint8_t* bufptr;     /* Casted version of arg buffer */
-    unsigned long flags; /* Save variable for flags */
+    iovec_t iov; /* The buffer as the one buffer of a writev */
     
     /* Checking for invalid params */
     if (!buf)
@@ -170,23 +196,70 @@ int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes)
         return -1;
     }
     
-    /* Start critical section */
-    cli_and_save(flags);
+    iov.base = (void*)buf;
+    iov.len = nbytes;
+    return terminal_writev(fd, &iov, 1);
+}
 
-    /* Casting arg buf */
-    bufptr = (uint8_t*)buf;
+/*
+ * terminal_writev
+ *   DESCRIPTION:  Writes TO the screen from several buffers, as one span.
+ *                 Small buffers are gathered into the same chunk, so the
+ *                 lock is taken and the cursor moved once per chunk rather
+ *                 than once per buffer.
+ *   INPUTS: iov: The buffers, already checked by sys_writev
+ *             iovcnt: The number of buffers
+ *   OUTPUTS: Screen display
+ *   RETURN VALUE: Number of bytes written
+ *   SIDE EFFECTS: All data is displayed to the screen immediately.
+ */
+int32_t terminal_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+{
+    /* Local variables */
+    int i;               /* Index of the buffer being copied */
+    int offset;          /* Bytes of that buffer already copied */
+    int count;           /* Number of bytes in the current chunk */
+    int size;            /* Bytes to copy from the buffer into the chunk */
+    int total;           /* Number of bytes written */
+    uint8_t chunk[INPUT_BUFFER_SIZE]; /* Copy of part of the buffers */
+    unsigned long flags; /* Save variable for flags */
     
-    /* Printing what's inside the arg buf */
-    for (i = 0; i < nbytes; i++)
+    /* Printing what's inside the buffers, one chunk at a time */
+    i = 0;
+    offset = 0;
+    total = 0;
+    while (i < iovcnt)
     {
-        putc(bufptr[i]);
+        /* Copy the chunk before taking the lock, so a bad pointer can't fault while it's held */
+        for (count = 0; (count < INPUT_BUFFER_SIZE) && (i < iovcnt); count += size)
+        {
+            size = iov[i].len - offset;
+            if (size > INPUT_BUFFER_SIZE - count)
+            {
+                size = INPUT_BUFFER_SIZE - count;
+            }
+            memcpy(chunk + count, (uint8_t*)iov[i].base + offset, size);
+            offset += size;
+            if (offset == iov[i].len)
+            {
+                i++;
+                offset = 0;
+            }
+        }
+        
+        /* Start critical section */
+        spin_lock_irqsave(&terminal_lock, flags);
+        
+        putn(chunk, count);
+        
+        /* End critical section */
+        spin_unlock_irqrestore(&terminal_lock, flags);
+        
+        total += count;
     }
     
-    /* End critical section */
-    restore_flags(flags);
-    
     /* Return the number written */
-    return i;
+    return total;
 }
 
 
@@ -217,6 +290,7 @@ void terminal_interrupt(void)
     /* Local variables */
     uint8_t scancode;   /* Scancode received from the keyboard */
     uint8_t ascii_data; /* ASCII representation of that scancode */
+    uint32_t flags;     /* Save variable for flags */
 
     /* Get the scancode on keyborad interrupt and map it to the ASCII character */
     scancode = keyboard_interrupt();
@@ -224,6 +298,9 @@ void terminal_interrupt(void)
     
     /* TERMINAL_DEBUG(ascii_data); */
     
+    /* Start critical section; the commands below all run with the lock held */
+    spin_lock_irqsave(&terminal_lock, flags);
+    
     /* Analyzing the ASCII data */
     if (ascii_data & MSB_MASK)
     {
@@ -240,6 +317,9 @@ void terminal_interrupt(void)
             case ALT_F3:
                 alt_f3();
                 break;
+            case ALT_F4:
+                alt_f4();
+                break;
             case CTRL_C:
                 ctrl_c();
                 break;
@@ -272,10 +352,11 @@ void terminal_interrupt(void)
                 }
                 break;
             case NEWLINE:
-                /* Print newline and signal that input is over */
+                /* Print newline, signal that input is over and wake the reader */
                 putc_active(ascii_data);
                 ACTIVE_TERMINAL.input_status = INPUT_ENDED;
                 ACTIVE_TERMINAL.buffer_index++;
+                wake_up(&(ACTIVE_TERMINAL.input_queue));
                 break;
             default:
                 /* Print character and write to buffer only if there's space */
@@ -288,6 +369,9 @@ void terminal_interrupt(void)
                 break;
         }
     }
+    
+    /* End critical section */
+    spin_unlock_irqrestore(&terminal_lock, flags);
 }
 
 
@@ -301,18 +385,10 @@ void terminal_interrupt(void)
  */
 void alt_f1(void)
 {
-    uint32_t flags;
-    
-    cli_and_save(flags);
-    /* Local variables */
-    
     if (active_terminal != 0)
     {
         switch_terminals(0);
     }
-    
-    restore_flags(flags);
-    
 }
 
 
@@ -326,17 +402,10 @@ void alt_f1(void)
  */
 void alt_f2(void)
 {
-    uint32_t flags;
-    
-    cli_and_save(flags);
-    /* Local variables */
-    
     if (active_terminal != 1)
     {
         switch_terminals(1);
     }
-    
-    restore_flags(flags);
 }
 
 
@@ -350,18 +419,27 @@ void alt_f2(void)
  */
 void alt_f3(void)
 {
-    uint32_t flags;
-    
-    cli_and_save(flags);
-    /* Local variables */
-    
     if (active_terminal != 2)
     {
         switch_terminals(2);
     }
-    
-    restore_flags(flags);
-    
+}
+
+
+/*
+ * alt_f4
+ *   DESCRIPTION: Runs the command sequence invoked by ALT + F4 key combo
+ *   INPUTS: None
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: Clears the screen and reprints the curren input
+ */
+void alt_f4(void)
+{
+    if (active_terminal != 3)
+    {
+        switch_terminals(3);
+    }
 }
 
 
@@ -375,20 +453,24 @@ void alt_f3(void)
  */
 void ctrl_c(void)
 {
-    uint32_t flags;
+    /* Local variables */
     terminal_t* current_terminal;
     
-    cli_and_save(flags);
-    /* Local variables */
-    /* None at the moment */
+    /* Neither a blocked process nor the idle task is running anything that can be interrupted */
+    if ((CURRENT_PID == IDLE_PID) || (CURRENT_PCB_ADDRESS->state != TASK_RUNNABLE))
+    {
+        return;
+    }
+    
     current_terminal = CURRENT_PCB_ADDRESS->terminal;
     /* Call sys_halt on the user side */
     current_terminal->input_status = INPUT_ENDED;
     reset_buffer();
     send_eoi(KEYBOARD_IRQ);
-    sys_halt(0);
     
-    restore_flags(flags);
+    /* sys_halt never returns, so let go of the lock (interrupts stay off) */
+    spin_unlock(&terminal_lock);
+    sys_halt(0);
 }
 
 
@@ -402,11 +484,8 @@ void ctrl_c(void)
  */
 void ctrl_l(void)
 {
-    uint32_t flags;
-    uint8_t i; /* Iteration variable */
-    
-    cli_and_save(flags);
     /* Local variables */
+    uint8_t i; /* Iteration variable */
     
     /* Reset screen and redraw current input */
     reset_screen_active();
@@ -414,8 +493,6 @@ void ctrl_l(void)
     {
         putc_active(ACTIVE_TERMINAL.input_buffer[i]);
     }
-    
-    restore_flags(flags);
 }
 
 
@@ -429,19 +506,14 @@ void ctrl_l(void)
  */
 void reset_buffer(void)
 {
-    uint32_t flags;
-    
-    cli_and_save(flags);
     /* Overwrite the buffer and reset the index */
     memset(ACTIVE_TERMINAL.input_buffer, NEWLINE, INPUT_BUFFER_SIZE);
     ACTIVE_TERMINAL.buffer_index = 0;
-    
-    restore_flags(flags);
 }
 
 /*
  * switch_terminals
- *   DESCRIPTION: Switch between terminals with Alt + F1/F2/F3 for CP5.
+ *   DESCRIPTION: Switch between terminals with Alt + F1/F2/F3/F4.
  *   INPUTS: 0, 1, or 2, value of the next terminal window
  *   OUTPUTS: None
  *   RETURN VALUE: None
@@ -452,10 +524,6 @@ void switch_terminals(uint32_t next_terminal)
     /* Local variables */
     terminal_t* old_terminal; /* Pointers to the current terminal and */
     terminal_t* new_terminal; /* the terminal we are switching into */
-    uint32_t flags; /* Save variable for the value of eflags */
-    
-    /* Start critical section */
-    cli_and_save(flags);
     
     /* Updating terminal active statuses and indicating that there's a new active terminal */
     old_terminal = &(ACTIVE_TERMINAL);
@@ -466,8 +534,8 @@ void switch_terminals(uint32_t next_terminal)
     
     /* Unit mapping the relevant video addresses to make memcpys easier */
     map_virt_to_phys((uint8_t*)BASE_VIDEO_MEM,(uint8_t*)BASE_VIDEO_MEM);
-    map_virt_to_phys(old_terminal->video_mem, old_terminal->video_mem);
-    map_virt_to_phys(new_terminal->video_mem, new_terminal->video_mem);
+    map_virt_to_phys(old_terminal->video_mem, (uint8_t*)old_terminal->video_backing);
+    map_virt_to_phys(new_terminal->video_mem, (uint8_t*)new_terminal->video_backing);
     
     /* Copy the current video memory into the old terminal's buffer */
     memcpy(old_terminal->video_mem, (uint8_t*)BASE_VIDEO_MEM, FOUR_K);
@@ -477,23 +545,40 @@ void switch_terminals(uint32_t next_terminal)
     /* Mask the new terminals buffer address to the physical video memory */
     map_virt_to_phys(new_terminal->video_mem, (uint8_t*) BASE_VIDEO_MEM);
     
-    if(CURRENT_TASK.terminal->active)
+    /* Every processor maps the user video page of the process it's running
+     * itself, so the others are told to remap theirs */
+    if (CURRENT_PCB_ADDRESS->terminal)
     {
-        /* If the current task is now on the active terminal, map it's user video page to video memory */
-        map_virt_to_phys((uint8_t*)VIRTUAL_END,(uint8_t*)BASE_VIDEO_MEM);
+        terminal_map_vidmap(CURRENT_PCB_ADDRESS->terminal);
     }
-    else
+    if (apic_enabled && (num_cpus > 1))
     {
-        /* Otherwise just map to the new terminal's buffer */
-        map_virt_to_phys((uint8_t*)BASE_VIDEO_MEM, new_terminal->video_mem);
-        map_virt_to_phys((uint8_t*)VIRTUAL_END, new_terminal->video_mem);
+        lapic_broadcast_ipi(REMAP_INTERRUPT);
     }
     
     /* Update the cursor on the active terminal */
     update_cursor_active();
-    
-    /* End critical section */
-    restore_flags(flags);
+}
+
+/*
+ * terminal_map_vidmap
+ *   DESCRIPTION: Maps this processor's user video page to the screen if the
+ *                terminal is active, or to the terminal's backing page if not
+ *   INPUTS: terminal: Terminal of the process running on this processor
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: Flushes this processor's TLB
+ */
+void terminal_map_vidmap(terminal_t* terminal)
+{
+    if (terminal->active)
+    {
+        map_virt_to_phys((uint8_t*)VIRTUAL_END, (uint8_t*)BASE_VIDEO_MEM);
+    }
+    else
+    {
+        map_virt_to_phys((uint8_t*)VIRTUAL_END, (uint8_t*)terminal->video_backing);
+    }
 }
 
 
@@ -6,6 +6,7 @@
 #define _TERMINAL_H
 
 #include "types.h"
+#include "wait_queue.h"
 
 /* Bitmask to expose only the MSB */
 #define MSB_MASK 0x80
@@ -41,8 +42,8 @@
 #define INPUT_ENDED 0x00
 #define IN_PROGRESS 0xFF
 
-/* Number of allowed terminals (should be the same as NUM_TASKS) */
-#define NUM_TERMINALS 0x03
+/* Number of allowed terminals */
+#define NUM_TERMINALS 0x04
 
 /* Address of the video memory in physical memory */
 #define VIDEO_MEM 0xB8000
@@ -52,6 +53,7 @@
 #define TERMINAL_1_VIDEO_MEM 0xB9000
 #define TERMINAL_2_VIDEO_MEM 0xBA000
 #define TERMINAL_3_VIDEO_MEM 0xBB000
+#define TERMINAL_4_VIDEO_MEM 0xBC000
 
 /* "Boolean" flags for determining if a given terminal is active */
 #define ACTIVE   0xFF
@@ -67,14 +69,16 @@
 #define ACTIVE_TERMINAL terminals[active_terminal]
 
 /* Struct for holding the terminal for task switching */
-typedef struct {
+typedef struct terminal {
     uint32_t terminal_number; /* Index into the terminal array */
     uint8_t* video_mem; /* Private video address for buffer */
+    uint32_t video_backing; /* Physical page holding the screen while the terminal isn't active */
     uint32_t screen_x; /* Holds the coords of the current display location */
     uint32_t screen_y;
     uint8_t input_buffer[INPUT_BUFFER_SIZE]; /* Input buffer from command line */
     uint8_t buffer_index; /* Index into the input buffer */
     volatile uint8_t input_status; /* Status of the input (i.e. has enter been pressed) */
+    wait_queue_t input_queue; /* Tasks sleeping until enter is pressed */
     uint8_t active; /* Flag for indicating whether or not this terminal is active */
 } terminal_t;
 
@@ -93,10 +97,17 @@ extern int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes);
 /* Write to the terminal */
 extern int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes);
 
+/* Write several buffers to the terminal as one span */
+struct iovec;
+extern int32_t terminal_writev(int32_t fd, const struct iovec* iov, int32_t iovcnt);
+
 /* Close the terminal */
 extern int32_t terminal_close(int32_t fd);
 
 /* Called on keyboard interrupt */
 extern void terminal_interrupt(void);
 
+/* Map this processor's user video page for a process on the given terminal */
+extern void terminal_map_vidmap(terminal_t* terminal);
+
 #endif /* _TERMINAL_H */
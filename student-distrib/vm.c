@@ -0,0 +1,1074 @@
+/* vm.c - Functions for demand paged user address spaces
+ * vim:ts=4 noexpandtab
+ */
+
+#include "vm.h"
+#include "process.h"
+#include "paging.h"
+#include "frame.h"
+#include "lib.h"
+#include "sys_call.h"
+#include "file_drivers.h"
+#include "shm.h"
+#include "spinlock.h"
+
+static exec_template_t* find_template(uint32_t inode);
+static exec_template_t* replace_template(void);
+static int32_t load_template(exec_template_t* template, uint32_t inode);
+static void release_template(exec_template_t* template);
+static void release_tables(uint32_t** tables);
+static int32_t add_table(uint32_t** tables, uint32_t address);
+static uint32_t* user_pte(uint32_t** tables, uint32_t address);
+static vm_area_t* grow_stack(pcb_t* pcb, uint32_t address);
+static vm_area_t* find_area(pcb_t* pcb, uint32_t address);
+static vm_area_t* find_flagged_area(pcb_t* pcb, uint32_t flag);
+static uint32_t area_limit(pcb_t* pcb, vm_area_t* area);
+static void unmap_page(pcb_t* pcb, uint32_t page);
+static uint32_t file_block(vm_area_t* area, uint32_t page);
+static int32_t fill_page(vm_area_t* area, uint32_t* pte, uint32_t page, uint32_t write);
+
+/* Executables that have been run, which new processes start as copies of */
+static exec_template_t templates[MAX_EXEC_TEMPLATES];
+
+/* Slot the next new template replaces */
+static uint32_t next_template = 0;
+
+/* Lock protecting the templates */
+static spinlock_t template_lock = SPINLOCK_UNLOCKED;
+
+/*
+ * vm_exec
+ *   DESCRIPTION: Gives a process the address space of an ELF file. The file is
+ *                parsed and its pages mapped into a template the first time it
+ *                runs; every process started from it after that begins as a
+ *                copy of the template, sharing the pages copy-on-write, so
+ *                starting one (a shell, say) reads nothing from the file, and
+ *                every running copy of a program shares one copy of its text.
+ *   INPUTS: pcb: The process
+ *           inode: Inode of the ELF file
+ *   OUTPUTS: entry: The program's entry point
+ *   RETURN VALUE: 0 on success, -1 if the file isn't a valid executable or
+ *                 memory is full
+ *   SIDE EFFECTS: None
+ */
+int32_t vm_exec(pcb_t* pcb, uint32_t inode, uint32_t* entry)
+{
+    /* Local variables */
+    exec_template_t* template; /* Template of the file */
+    uint32_t* table;           /* Template's page table being copied */
+    uint32_t flags;            /* Save variable for flags */
+    uint32_t i, j;
+
+    pcb->num_vm_areas = 0;
+
+    spin_lock_irqsave(&template_lock, flags);
+
+    if (!(template = find_template(inode)))
+    {
+        template = replace_template();
+        release_template(template);
+        if (load_template(template, inode) == -1)
+        {
+            spin_unlock_irqrestore(&template_lock, flags);
+            vm_release(pcb);
+            return -1;
+        }
+    }
+
+    /* The program has to leave room for the stack to grow to its limit */
+    if (template->brk > VIRTUAL_END - pcb->stack_limit)
+    {
+        spin_unlock_irqrestore(&template_lock, flags);
+        return -1;
+    }
+
+    /* The template's pages are already read-only or copy-on-write, so they can just be shared */
+    for (i = 0; i < USER_TABLES; i++)
+    {
+        if (!(table = template->page_tables[i]))
+        {
+            continue;
+        }
+        if (!(pcb->page_tables[i] = get_new_entry()))
+        {
+            spin_unlock_irqrestore(&template_lock, flags);
+            vm_release(pcb);
+            return -1;
+        }
+        for (j = 0; j < SIZE_TABLE; j++)
+        {
+            if ((table[j] & PAGE_PRESENT) && !(table[j] & PAGE_FILE))
+            {
+                frame_share(table[j] & PAGE_TABLE_MASK);
+            }
+            pcb->page_tables[i][j] = table[j];
+        }
+    }
+    memcpy(pcb->vm_areas, template->vm_areas, sizeof(pcb->vm_areas));
+    pcb->num_vm_areas = template->num_vm_areas;
+    pcb->brk = template->brk;
+    pcb->template = template;
+    template->users++;
+    *entry = template->entry;
+
+    spin_unlock_irqrestore(&template_lock, flags);
+    return 0;
+}
+
+/*
+ * vm_release
+ *   DESCRIPTION: Frees every page the process was given and its page tables.
+ *                Pages mapped from the filesystem image aren't the process's,
+ *                so they are left alone, and shared memory segments just lose
+ *                a mapping.
+ *   INPUTS: pcb: The process, which must not be the one mapped in
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void vm_release(pcb_t* pcb)
+{
+    uint32_t flags; /* Save variable for flags */
+    uint32_t i;
+
+    spin_lock_irqsave(&template_lock, flags);
+    if (pcb->template)
+    {
+        pcb->template->users--;
+        pcb->template = NULL;
+    }
+    spin_unlock_irqrestore(&template_lock, flags);
+
+    release_tables(pcb->page_tables);
+
+    for (i = 0; i < pcb->num_vm_areas; i++)
+    {
+        if (pcb->vm_areas[i].flags & VM_SHM)
+        {
+            shm_put(pcb->vm_areas[i].inode);
+        }
+    }
+
+    pcb->num_vm_areas = 0;
+}
+
+/*
+ * vm_fork
+ *   DESCRIPTION: Gives a forked child a copy of its parent's page tables and
+ *                areas. Private pages are shared: writable ones become
+ *                copy-on-write in both processes, so neither sees the other's
+ *                writes. Pages of the filesystem image are mapped as they were,
+ *                and shared memory stays shared.
+ *   INPUTS: child: The new process
+ *           parent: The process forking, which must be the one mapped in
+ *   OUTPUTS: None
+ *   RETURN VALUE: 0 on success, -1 if memory is full
+ *   SIDE EFFECTS: Flushes the TLB
+ */
+int32_t vm_fork(pcb_t* child, pcb_t* parent)
+{
+    uint32_t entry; /* Page table entry being copied */
+    uint32_t flags; /* Save variable for flags */
+    uint32_t i, j;
+
+    /* The child's PCB was copied from the parent, but none of this is its own yet */
+    memset(child->page_tables, 0, sizeof(child->page_tables));
+    child->num_vm_areas = 0;
+
+    /* The child runs the same program, so it keeps the template too */
+    spin_lock_irqsave(&template_lock, flags);
+    if ((child->template = parent->template))
+    {
+        child->template->users++;
+    }
+    spin_unlock_irqrestore(&template_lock, flags);
+
+    for (i = 0; i < USER_TABLES; i++)
+    {
+        if (!parent->page_tables[i])
+        {
+            continue;
+        }
+        if (!(child->page_tables[i] = get_new_entry()))
+        {
+            vm_release(child);
+            flush_TLB();
+            return -1;
+        }
+
+        for (j = 0; j < SIZE_TABLE; j++)
+        {
+            entry = parent->page_tables[i][j];
+            if (!(entry & PAGE_PRESENT))
+            {
+                continue;
+            }
+
+            if (!(entry & PAGE_FILE))
+            {
+                frame_share(entry & PAGE_TABLE_MASK);
+                if ((entry & PAGE_RW) && !(entry & PAGE_SHARED))
+                {
+                    entry = (entry & ~PAGE_RW) | PAGE_COW;
+                    parent->page_tables[i][j] = entry;
+                }
+            }
+            child->page_tables[i][j] = entry;
+        }
+    }
+
+    memcpy(child->vm_areas, parent->vm_areas, sizeof(child->vm_areas));
+    child->num_vm_areas = parent->num_vm_areas;
+    for (i = 0; i < child->num_vm_areas; i++)
+    {
+        if (child->vm_areas[i].flags & VM_SHM)
+        {
+            shm_get(child->vm_areas[i].inode);
+        }
+    }
+
+    /* The parent's writable pages were just made read-only */
+    flush_TLB();
+    return 0;
+}
+
+/*
+ * vm_brk
+ *   DESCRIPTION: Moves the end of a process's heap, back down to where the heap
+ *                starts or up to whichever comes first: the heap limit, the
+ *                room kept for the stack to grow to its limit, or the next area
+ *                (shared memory). Growing only extends the heap area; its pages
+ *                are zero filled when first touched. Pages the heap shrinks off
+ *                are freed.
+ *   INPUTS: pcb: The process, which must be the one mapped in
+ *           increment: Number of bytes to grow the heap by (negative shrinks it)
+ *   OUTPUTS: None
+ *   RETURN VALUE: The old end of the heap, or -1 if the new one is out of range
+ *   SIDE EFFECTS: None
+ */
+int32_t vm_brk(pcb_t* pcb, int32_t increment)
+{
+    /* Local variables */
+    vm_area_t* heap;  /* Heap area */
+    uint32_t old;     /* Old end of the heap */
+    uint32_t new;     /* New end of the heap */
+    uint32_t end;     /* New end of the heap area (page aligned) */
+    uint32_t page;    /* Page being freed */
+
+    if (!(heap = find_flagged_area(pcb, VM_HEAP)))
+    {
+        return -1;
+    }
+
+    old = pcb->brk;
+    if (increment >= 0)
+    {
+        new = old + increment;
+        if ((new < old) || (new > area_limit(pcb, heap)) ||
+                (new > VIRTUAL_END - pcb->stack_limit) || (new - heap->start > pcb->heap_limit))
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        if ((uint32_t)0 - (uint32_t)increment > old - heap->start)
+        {
+            return -1;
+        }
+        new = old + increment;
+    }
+
+    end = (new + PAGE_SIZE - 1) & PAGE_TABLE_MASK;
+    for (page = end; page < heap->end; page += PAGE_SIZE)
+    {
+        unmap_page(pcb, page);
+    }
+
+    heap->end = end;
+    pcb->brk = new;
+    return old;
+}
+
+/*
+ * vm_set_limit
+ *   DESCRIPTION: Sets how far a process's stack or heap can grow. A stack limit
+ *                is rounded up to a page, and has to cover the stack as it is
+ *                without reaching into the heap; a heap limit has to cover the
+ *                heap as it is.
+ *   INPUTS: pcb: The process
+ *           resource: LIMIT_STACK or LIMIT_HEAP
+ *           limit: Most bytes the stack or heap can grow to
+ *   OUTPUTS: None
+ *   RETURN VALUE: The old limit, or -1 if the limit can't be set
+ *   SIDE EFFECTS: None
+ */
+int32_t vm_set_limit(pcb_t* pcb, uint32_t resource, uint32_t limit)
+{
+    /* Local variables */
+    vm_area_t* stack; /* Stack area */
+    vm_area_t* heap;  /* Heap area */
+    uint32_t old;     /* Old limit */
+
+    if (!(stack = find_flagged_area(pcb, VM_STACK)) || !(heap = find_flagged_area(pcb, VM_HEAP)))
+    {
+        return -1;
+    }
+
+    switch (resource)
+    {
+        case LIMIT_STACK:
+            if (limit > VIRTUAL_END - VIRTUAL_BEGIN)
+            {
+                return -1;
+            }
+            limit = (limit + PAGE_SIZE - 1) & PAGE_TABLE_MASK;
+            if ((limit < VIRTUAL_END - stack->start) || (VIRTUAL_END - limit < pcb->brk))
+            {
+                return -1;
+            }
+            old = pcb->stack_limit;
+            pcb->stack_limit = limit;
+            return old;
+
+        case LIMIT_HEAP:
+            if (limit < pcb->brk - heap->start)
+            {
+                return -1;
+            }
+            old = pcb->heap_limit;
+            pcb->heap_limit = limit;
+            return old;
+
+        default:
+            return -1;
+    }
+}
+
+/*
+ * vm_map_shared
+ *   DESCRIPTION: Maps frames that are shared with other processes into a
+ *                process as a writable area. Each page counts as another
+ *                mapping of its frame, so freeing the process only drops it.
+ *   INPUTS: pcb: The process, which must be the one mapped in
+ *           address: Where the area starts (page aligned)
+ *           frames: Frame of each page
+ *           num_pages: Number of pages
+ *           id: Shared memory segment the frames belong to
+ *   OUTPUTS: None
+ *   RETURN VALUE: 0 on success, -1 if the area would leave the user window,
+ *                 overlap another area, or the process has too many areas
+ *   SIDE EFFECTS: None
+ */
+int32_t vm_map_shared(pcb_t* pcb, uint32_t address, uint32_t* frames, uint32_t num_pages, int32_t id)
+{
+    /* Local variables */
+    vm_area_t* area; /* New area */
+    uint32_t end;    /* Address just past the area */
+    uint32_t i;
+
+    end = address + num_pages * PAGE_SIZE;
+    if (!pcb->num_vm_areas || (address & (PAGE_SIZE - 1)) || (address < PROGRAM_PAGE_START) ||
+            (address >= VIRTUAL_END) || (end > VIRTUAL_END) || (end <= address) ||
+            (pcb->num_vm_areas >= MAX_VM_AREAS))
+    {
+        return -1;
+    }
+    for (i = 0; i < pcb->num_vm_areas; i++)
+    {
+        if ((address < pcb->vm_areas[i].end) && (pcb->vm_areas[i].start < end))
+        {
+            return -1;
+        }
+    }
+
+    /* Every page needs a page table before anything is mapped */
+    for (i = 0; i < num_pages; i++)
+    {
+        if (add_table(pcb->page_tables, address + i * PAGE_SIZE) == -1)
+        {
+            return -1;
+        }
+    }
+    vm_switch(pcb);
+
+    area = &(pcb->vm_areas[pcb->num_vm_areas++]);
+    area->start = address;
+    area->end = end;
+    area->flags = VM_WRITE | VM_SHM;
+    area->inode = id;
+    area->offset = 0;
+    area->zero_start = end;
+
+    for (i = 0; i < num_pages; i++)
+    {
+        frame_share(frames[i]);
+        *user_pte(pcb->page_tables, address + i * PAGE_SIZE) = frames[i] | PAGE_SHARED | USER_LVL | PAGE_RW | PAGE_PRESENT;
+    }
+    return 0;
+}
+
+/*
+ * vm_unmap_shared
+ *   DESCRIPTION: Removes the shared memory area that starts at an address
+ *   INPUTS: pcb: The process, which must be the one mapped in
+ *           address: Where the area starts
+ *   OUTPUTS: None
+ *   RETURN VALUE: The area's segment ID, or -1 if there's no shared memory there
+ *   SIDE EFFECTS: Flushes the area's TLB entries
+ */
+int32_t vm_unmap_shared(pcb_t* pcb, uint32_t address)
+{
+    /* Local variables */
+    vm_area_t* area; /* Area being removed */
+    int32_t id;      /* Segment the area belongs to */
+    uint32_t page;   /* Page being unmapped */
+
+    if (!pcb->num_vm_areas || !(area = find_area(pcb, address)) ||
+            !(area->flags & VM_SHM) || (area->start != address))
+    {
+        return -1;
+    }
+
+    for (page = area->start; page < area->end; page += PAGE_SIZE)
+    {
+        unmap_page(pcb, page);
+    }
+
+    id = area->inode;
+    *area = pcb->vm_areas[--pcb->num_vm_areas];
+    return id;
+}
+
+/*
+ * vm_switch
+ *   DESCRIPTION: Maps the user window to a process's page tables
+ *   INPUTS: pcb: The process (the idle task leaves the window unmapped)
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: Flushes the TLB
+ */
+void vm_switch(pcb_t* pcb)
+{
+    table_modify(VIRTUAL_BEGIN, pcb->page_tables, USER_TABLES, USER_PRIV);
+}
+
+/*
+ * vm_fault
+ *   DESCRIPTION: Handles a page fault in the current process's user window. A
+ *                page that isn't present is filled in from its area (a page
+ *                just below the stack grows the stack, up to its limit); a write to
+ *                a copy-on-write page gets a private copy, unless the process
+ *                is the last one sharing it.
+ *   INPUTS: address: Address that faulted (from CR2)
+ *           error_code: Error code the processor pushed
+ *   OUTPUTS: None
+ *   RETURN VALUE: 0 if the faulting instruction can be retried, -1 if the
+ *                 access was invalid
+ *   SIDE EFFECTS: None
+ */
+int32_t vm_fault(uint32_t address, uint32_t error_code)
+{
+    /* Local variables */
+    pcb_t* pcb = CURRENT_PCB_ADDRESS; /* Process that faulted */
+    vm_area_t* area;                  /* Area the address is in */
+    uint32_t* pte;                    /* Page table entry of the address */
+    uint32_t frame;                   /* Frame the page is mapped to */
+    uint32_t copy;                    /* Frame of a private copy */
+
+    if (!pcb->num_vm_areas || (address < VIRTUAL_BEGIN) || (address >= VIRTUAL_END))
+    {
+        return -1;
+    }
+    if (!(area = find_area(pcb, address)) && !(area = grow_stack(pcb, address)))
+    {
+        return -1;
+    }
+    if ((error_code & FAULT_WRITE) && !(area->flags & VM_WRITE))
+    {
+        return -1;
+    }
+
+    /* The first page in a 4MB region needs a page table for it */
+    if (!pcb->page_tables[USER_TABLE(address)])
+    {
+        if (add_table(pcb->page_tables, address) == -1)
+        {
+            return -1;
+        }
+        vm_switch(pcb);
+    }
+
+    pte = user_pte(pcb->page_tables, address);
+    if (!(*pte & PAGE_PRESENT))
+    {
+        return fill_page(area, pte, address & PAGE_TABLE_MASK, error_code & FAULT_WRITE);
+    }
+
+    /* Only writes to copy-on-write pages can be fixed up */
+    if (!(error_code & FAULT_WRITE) || !(*pte & PAGE_COW))
+    {
+        return -1;
+    }
+    frame = *pte & PAGE_TABLE_MASK;
+    if ((*pte & PAGE_FILE) || frame_shared(frame))
+    {
+        if (!(copy = frame_alloc(FRAME_ORDER_4K)))
+        {
+            return -1;
+        }
+        memcpy((void*)copy, (void*)frame, PAGE_SIZE);
+
+        /* Drop this process's share of the old frame */
+        if (!(*pte & PAGE_FILE))
+        {
+            frame_free(frame, FRAME_ORDER_4K);
+        }
+        frame = copy;
+    }
+
+    *pte = frame | USER_LVL | PAGE_ON;
+    flush_TLB_page(address);
+    return 0;
+}
+
+/*
+ * vm_user_range
+ *   DESCRIPTION: Checks that a buffer a process passed to a system call lies
+ *                entirely in the user window, so the kernel can't be made to
+ *                read or write its own memory through it
+ *   INPUTS: buf: Start of the buffer
+ *           nbytes: Length of the buffer
+ *   OUTPUTS: None
+ *   RETURN VALUE: 0 if the buffer is in the user window, -1 if not (or if
+ *                 nbytes is negative)
+ *   SIDE EFFECTS: None
+ */
+int32_t vm_user_range(const void* buf, int32_t nbytes)
+{
+    if ((nbytes < 0) || (nbytes > VIRTUAL_END - VIRTUAL_BEGIN) ||
+            ((uint32_t)buf < VIRTUAL_BEGIN) || ((uint32_t)buf > VIRTUAL_END - nbytes))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * find_template
+ *   DESCRIPTION: Finds the template of an executable. template_lock must be held.
+ *   INPUTS: inode: Inode of the executable
+ *   OUTPUTS: None
+ *   RETURN VALUE: The template, or NULL if the file has none
+ *   SIDE EFFECTS: None
+ */
+static exec_template_t* find_template(uint32_t inode)
+{
+    uint32_t i;
+
+    for (i = 0; i < MAX_EXEC_TEMPLATES; i++)
+    {
+        if (templates[i].num_vm_areas && (templates[i].inode == inode))
+        {
+            return &templates[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * replace_template
+ *   DESCRIPTION: Picks the slot a new template goes in: a free one, or else the
+ *                templates are replaced in turn, skipping the ones that running
+ *                processes were started from unless every one of them is.
+ *                template_lock must be held.
+ *   INPUTS: None
+ *   OUTPUTS: None
+ *   RETURN VALUE: The slot, which may still hold a template
+ *   SIDE EFFECTS: None
+ */
+static exec_template_t* replace_template(void)
+{
+    /* Local variables */
+    exec_template_t* template; /* Slot being looked at */
+    uint32_t i;
+
+    for (i = 0; i < MAX_EXEC_TEMPLATES; i++)
+    {
+        if (!templates[i].num_vm_areas)
+        {
+            return &templates[i];
+        }
+    }
+
+    for (i = 0; i < MAX_EXEC_TEMPLATES; i++)
+    {
+        template = &templates[next_template];
+        next_template = (next_template + 1) % MAX_EXEC_TEMPLATES;
+        if (!template->users)
+        {
+            return template;
+        }
+    }
+
+    /* Processes keep their own share of the pages, so a template in use can go
+     * too; they just stop counting towards it */
+    template = &templates[next_template];
+    next_template = (next_template + 1) % MAX_EXEC_TEMPLATES;
+    spin_lock(&process_lock);
+    for (i = 0; i < MAX_PIDS; i++)
+    {
+        if (pid_table[i] && (pid_table[i]->template == template))
+        {
+            pid_table[i]->template = NULL;
+        }
+    }
+    spin_unlock(&process_lock);
+    template->users = 0;
+    return template;
+}
+
+/*
+ * load_template
+ *   DESCRIPTION: Fills in a template from an ELF file: an area for each
+ *                loadable segment, plus an empty heap after the highest segment
+ *                and a one page stack at the top of the user window. Every page that
+ *                holds part of the file is mapped, which mostly just points it
+ *                at its filesystem block; writable pages are made copy-on-write
+ *                so processes can share them. The heap and stack are zero
+ *                filled as they are touched. template_lock must be held.
+ *   INPUTS: template: A free template
+ *           inode: Inode of the ELF file
+ *   OUTPUTS: None
+ *   RETURN VALUE: 0 on success, -1 if the file isn't a valid executable or
+ *                 memory is full (the template is left free)
+ *   SIDE EFFECTS: None
+ */
+static int32_t load_template(exec_template_t* template, uint32_t inode)
+{
+    /* Local variables */
+    elf_header_t header;          /* Header of the file */
+    elf_program_header_t segment; /* Program header being mapped */
+    inode_t file;                 /* Inode of the file (for its length) */
+    vm_area_t* area;              /* Area being filled in */
+    uint32_t* pte;                /* Page table entry being filled in */
+    uint32_t highest;             /* End of the highest segment */
+    uint32_t stack_start;         /* Lowest address of the stack */
+    uint32_t page;                /* Page being mapped */
+    uint32_t i, j;
+
+    template->inode = inode;
+    template->num_vm_areas = 0;
+
+    get_inode(inode, &file);
+    if ((read_data(inode, 0, (uint8_t*)&header, sizeof(header)) != sizeof(header)) ||
+            (header.magic != ELF_HEADER) || (header.phentsize < sizeof(segment)))
+    {
+        release_template(template);
+        return -1;
+    }
+
+    highest = PROGRAM_PAGE_START;
+    for (i = 0; i < header.phnum; i++)
+    {
+        if (read_data(inode, header.phoff + i * header.phentsize, (uint8_t*)&segment, sizeof(segment)) != sizeof(segment))
+        {
+            release_template(template);
+            return -1;
+        }
+        if (segment.type != PT_LOAD)
+        {
+            continue;
+        }
+
+        /* The segment has to fit in the user window (leaving room for the stack)
+         * and line up with the file's blocks so they can be mapped straight in */
+        if ((segment.filesz > segment.memsz) || (segment.vaddr < PROGRAM_PAGE_START) ||
+                (segment.vaddr >= VIRTUAL_END) || (segment.memsz > VIRTUAL_END - segment.vaddr) ||
+                ((segment.vaddr - segment.offset) & (PAGE_SIZE - 1)) ||
+                (segment.filesz > file.length) || (segment.offset > file.length - segment.filesz) ||
+                (template->num_vm_areas >= MAX_VM_AREAS - 2))
+        {
+            release_template(template);
+            return -1;
+        }
+
+        area = &(template->vm_areas[template->num_vm_areas]);
+        area->start = segment.vaddr & PAGE_TABLE_MASK;
+        area->end = (segment.vaddr + segment.memsz + PAGE_SIZE - 1) & PAGE_TABLE_MASK;
+        area->flags = VM_FILE | ((segment.flags & PF_W) ? VM_WRITE : 0);
+        area->inode = inode;
+        area->offset = segment.offset - (segment.vaddr - area->start);
+
+        /* Without a bss, the whole last page can come from the file */
+        area->zero_start = (segment.memsz > segment.filesz) ? segment.vaddr + segment.filesz : area->end;
+
+        for (j = 0; j < template->num_vm_areas; j++)
+        {
+            if ((area->start < template->vm_areas[j].end) && (template->vm_areas[j].start < area->end))
+            {
+                release_template(template);
+                return -1;
+            }
+        }
+        template->num_vm_areas++;
+
+        if (area->end > highest)
+        {
+            highest = area->end;
+        }
+    }
+
+    stack_start = VIRTUAL_END - PAGE_SIZE;
+    if ((highest > stack_start) || (header.entry < PROGRAM_PAGE_START) || (header.entry >= highest))
+    {
+        release_template(template);
+        return -1;
+    }
+
+    /* Map the pages with file contents; a private frame (a page that is only
+     * partly file, or an image that isn't page aligned) is shared copy-on-write */
+    for (i = 0; i < template->num_vm_areas; i++)
+    {
+        area = &(template->vm_areas[i]);
+        for (page = area->start; (page < area->end) && (page < area->zero_start); page += PAGE_SIZE)
+        {
+            if ((add_table(template->page_tables, page) == -1) ||
+                    (fill_page(area, pte = user_pte(template->page_tables, page), page, FALSE) == -1))
+            {
+                release_template(template);
+                return -1;
+            }
+            if (*pte & PAGE_RW)
+            {
+                *pte = (*pte & ~PAGE_RW) | PAGE_COW;
+            }
+        }
+    }
+
+    /* The heap starts out empty, right after the program */
+    area = &(template->vm_areas[template->num_vm_areas++]);
+    area->start = highest;
+    area->end = highest;
+    area->flags = VM_WRITE | VM_HEAP;
+    area->zero_start = highest;
+    template->brk = highest;
+
+    /* The stack is zero filled as it grows down */
+    area = &(template->vm_areas[template->num_vm_areas++]);
+    area->start = stack_start;
+    area->end = VIRTUAL_END;
+    area->flags = VM_WRITE | VM_STACK;
+    area->zero_start = stack_start;
+
+    template->entry = header.entry;
+    return 0;
+}
+
+/*
+ * release_template
+ *   DESCRIPTION: Frees a template's page tables, dropping its share of the
+ *                frames it mapped; processes started from it keep theirs.
+ *                template_lock must be held.
+ *   INPUTS: template: The template (which may already be free)
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+static void release_template(exec_template_t* template)
+{
+    release_tables(template->page_tables);
+    template->num_vm_areas = 0;
+}
+
+/*
+ * release_tables
+ *   DESCRIPTION: Frees the frames the page tables of a user window map (or
+ *                drops their share of them) and the tables themselves.
+ *                Filesystem blocks aren't freed.
+ *   INPUTS: tables: The page tables, which are all NULL afterwards
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+static void release_tables(uint32_t** tables)
+{
+    uint32_t i, j;
+
+    for (i = 0; i < USER_TABLES; i++)
+    {
+        if (!tables[i])
+        {
+            continue;
+        }
+        for (j = 0; j < SIZE_TABLE; j++)
+        {
+            if ((tables[i][j] & PAGE_PRESENT) && !(tables[i][j] & PAGE_FILE))
+            {
+                frame_free(tables[i][j] & PAGE_TABLE_MASK, FRAME_ORDER_4K);
+            }
+        }
+        free_entry(tables[i]);
+        tables[i] = NULL;
+    }
+}
+
+/*
+ * add_table
+ *   DESCRIPTION: Makes sure the 4MB region holding an address has a page table
+ *   INPUTS: tables: Page tables of a user window
+ *           address: Address in the user window
+ *   OUTPUTS: None
+ *   RETURN VALUE: 0 on success, -1 if memory is full
+ *   SIDE EFFECTS: A new table isn't mapped in until the next vm_switch
+ */
+static int32_t add_table(uint32_t** tables, uint32_t address)
+{
+    if (!tables[USER_TABLE(address)] && !(tables[USER_TABLE(address)] = get_new_entry()))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * user_pte
+ *   DESCRIPTION: Finds the page table entry of an address in a user window
+ *   INPUTS: tables: Page tables of the user window
+ *           address: Address in the user window
+ *   OUTPUTS: None
+ *   RETURN VALUE: Pointer to the entry, or NULL if its region has no page table
+ *   SIDE EFFECTS: None
+ */
+static uint32_t* user_pte(uint32_t** tables, uint32_t address)
+{
+    uint32_t* table = tables[USER_TABLE(address)];
+
+    return table ? &(table[(address >> TABLE_OFFSET) & TABLE_MASK]) : NULL;
+}
+
+/*
+ * grow_stack
+ *   DESCRIPTION: Grows a process's stack down to a page it faulted on, if the
+ *                page is within the stack limit and no other area is in the way
+ *   INPUTS: pcb: The process
+ *           address: Address that faulted, which isn't in any area
+ *   OUTPUTS: None
+ *   RETURN VALUE: The stack area, or NULL if it can't grow to the address
+ *   SIDE EFFECTS: None
+ */
+static vm_area_t* grow_stack(pcb_t* pcb, uint32_t address)
+{
+    /* Local variables */
+    vm_area_t* stack; /* Stack area */
+    uint32_t page;    /* New lowest page of the stack */
+    uint32_t i;
+
+    page = address & PAGE_TABLE_MASK;
+    if (!(stack = find_flagged_area(pcb, VM_STACK)) || (address >= stack->start) ||
+            (page < VIRTUAL_END - pcb->stack_limit))
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < pcb->num_vm_areas; i++)
+    {
+        if ((pcb->vm_areas[i].end > page) && (pcb->vm_areas[i].start < stack->start) &&
+                (&(pcb->vm_areas[i]) != stack))
+        {
+            return NULL;
+        }
+    }
+
+    stack->start = page;
+    stack->zero_start = page;
+    return stack;
+}
+
+/*
+ * find_area
+ *   DESCRIPTION: Finds the area of a process's address space an address is in
+ *   INPUTS: pcb: The process
+ *           address: User address
+ *   OUTPUTS: None
+ *   RETURN VALUE: The area, or NULL if the address isn't in one
+ *   SIDE EFFECTS: None
+ */
+static vm_area_t* find_area(pcb_t* pcb, uint32_t address)
+{
+    uint32_t i;
+
+    for (i = 0; i < pcb->num_vm_areas; i++)
+    {
+        if ((address >= pcb->vm_areas[i].start) && (address < pcb->vm_areas[i].end))
+        {
+            return &(pcb->vm_areas[i]);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * find_flagged_area
+ *   DESCRIPTION: Finds the area of a process's address space with a flag, such
+ *                as the heap or the stack
+ *   INPUTS: pcb: The process
+ *           flag: VM_HEAP or VM_STACK
+ *   OUTPUTS: None
+ *   RETURN VALUE: The area, or NULL if there is none
+ *   SIDE EFFECTS: None
+ */
+static vm_area_t* find_flagged_area(pcb_t* pcb, uint32_t flag)
+{
+    uint32_t i;
+
+    for (i = 0; i < pcb->num_vm_areas; i++)
+    {
+        if (pcb->vm_areas[i].flags & flag)
+        {
+            return &(pcb->vm_areas[i]);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * area_limit
+ *   DESCRIPTION: Finds how far an area could grow up before it ran into the
+ *                next area or the end of the user window
+ *   INPUTS: pcb: The process
+ *           area: The area
+ *   OUTPUTS: None
+ *   RETURN VALUE: Start of the next area above, or VIRTUAL_END
+ *   SIDE EFFECTS: None
+ */
+static uint32_t area_limit(pcb_t* pcb, vm_area_t* area)
+{
+    uint32_t limit = VIRTUAL_END;
+    uint32_t i;
+
+    for (i = 0; i < pcb->num_vm_areas; i++)
+    {
+        if ((pcb->vm_areas[i].start >= area->end) && (pcb->vm_areas[i].start < limit) &&
+                (&(pcb->vm_areas[i]) != area))
+        {
+            limit = pcb->vm_areas[i].start;
+        }
+    }
+
+    return limit;
+}
+
+/*
+ * unmap_page
+ *   DESCRIPTION: Unmaps a page of a process, freeing its frame (or dropping the
+ *                process's share of it)
+ *   INPUTS: pcb: The process, which must be the one mapped in
+ *           page: Address of the page
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: Flushes the page's TLB entry
+ */
+static void unmap_page(pcb_t* pcb, uint32_t page)
+{
+    uint32_t* pte = user_pte(pcb->page_tables, page);
+
+    if (!pte || !(*pte & PAGE_PRESENT))
+    {
+        return;
+    }
+    if (!(*pte & PAGE_FILE))
+    {
+        frame_free(*pte & PAGE_TABLE_MASK, FRAME_ORDER_4K);
+    }
+    *pte = NOT_PRESENT;
+    flush_TLB_page(page);
+}
+
+/*
+ * file_block
+ *   DESCRIPTION: Finds the filesystem block that a page of a file backed area
+ *                comes from, so it can be mapped without copying
+ *   INPUTS: area: The area
+ *           page: Address of the page
+ *   OUTPUTS: None
+ *   RETURN VALUE: Address of the block, or 0 if it can't be mapped (the page is
+ *                 past the end of the file, or the image isn't page aligned)
+ *   SIDE EFFECTS: None
+ */
+static uint32_t file_block(vm_area_t* area, uint32_t page)
+{
+    /* Local variables */
+    boot_block_t boot_block; /* Boot block (for where the data blocks start) */
+    inode_t inode;           /* Inode of the file */
+    uint32_t offset;         /* Offset of the page in the file */
+
+    if ((uint32_t)filesys_img & (PAGE_SIZE - 1))
+    {
+        return 0;
+    }
+
+    offset = area->offset + (page - area->start);
+    get_inode(area->inode, &inode);
+    if (offset >= inode.length)
+    {
+        return 0;
+    }
+
+    /* Data blocks come after the boot block and the inodes */
+    init_boot_block(&boot_block);
+    return (uint32_t)filesys_img + (boot_block.inodes_count + 1 + inode.data_blocks[offset / BLOCK_SIZE]) * BLOCK_SIZE;
+}
+
+/*
+ * fill_page
+ *   DESCRIPTION: Maps a page that isn't present yet. A page that comes entirely
+ *                from the file is mapped straight onto its filesystem block:
+ *                read-only for text, and copy-on-write for data that is only
+ *                being read. Anything else gets a zeroed frame, with whatever
+ *                part of the file belongs in it copied in.
+ *   INPUTS: area: Area the page is in
+ *           pte: Page table entry of the page
+ *           page: Address of the page
+ *           write: Nonzero if the fault was a write
+ *   OUTPUTS: None
+ *   RETURN VALUE: 0 on success, -1 if memory is full
+ *   SIDE EFFECTS: None
+ */
+static int32_t fill_page(vm_area_t* area, uint32_t* pte, uint32_t page, uint32_t write)
+{
+    /* Local variables */
+    uint32_t block; /* Filesystem block the page comes from */
+    uint32_t frame; /* Frame given to the page */
+    uint32_t bytes; /* Bytes of the page that come from the file */
+
+    if ((area->flags & VM_FILE) && (page + PAGE_SIZE <= area->zero_start) &&
+            (!write || !(area->flags & VM_WRITE)) && (block = file_block(area, page)))
+    {
+        *pte = block | PAGE_FILE | USER_LVL | PAGE_PRESENT | ((area->flags & VM_WRITE) ? PAGE_COW : 0);
+        return 0;
+    }
+
+    if (!(frame = frame_alloc(FRAME_ORDER_4K)))
+    {
+        return -1;
+    }
+    memset((void*)frame, 0, PAGE_SIZE);
+
+    if ((area->flags & VM_FILE) && (page < area->zero_start))
+    {
+        bytes = area->zero_start - page;
+        if (bytes > PAGE_SIZE)
+        {
+            bytes = PAGE_SIZE;
+        }
+        read_data(area->inode, area->offset + (page - area->start), (uint8_t*)frame, bytes);
+    }
+
+    *pte = frame | USER_LVL | PAGE_PRESENT | ((area->flags & VM_WRITE) ? PAGE_RW : 0);
+    return 0;
+}
@@ -0,0 +1,132 @@
+/* vm.h - Defines used for demand paged user address spaces
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _VM_H
+#define _VM_H
+
+#include "types.h"
+
+/* The user window, from 128MB up to 192MB; each 4MB of it gets its own page
+ * table once something is mapped there */
+#define VIRTUAL_BEGIN 0x08000000
+#define VIRTUAL_END   0x0C000000
+#define USER_TABLES ((VIRTUAL_END - VIRTUAL_BEGIN) >> 22)
+
+/* Index of the page table holding a user address */
+#define USER_TABLE(address) (((address) - VIRTUAL_BEGIN) >> 22)
+
+/* Most areas a process can have (its ELF segments, the heap, the stack and shared memory) */
+#define MAX_VM_AREAS 0x10
+
+/* Flags for vm areas */
+#define VM_WRITE 0x01 /* Area can be written */
+#define VM_FILE  0x02 /* Area starts with the contents of a file */
+#define VM_HEAP  0x04 /* Area is the heap, whose end sys_sbrk moves */
+#define VM_STACK 0x08 /* Area is the stack, which grows down as it is touched */
+#define VM_SHM   0x10 /* Area is a shared memory segment, mapped in whole */
+
+/* Bytes at the top of the user window kept for the stack, unless a process
+ * changes its limit; the heap can only grow up to the room left for it */
+#define DEFAULT_STACK_LIMIT 0x100000
+
+/* Resources sys_setlimit sets the limit of */
+#define LIMIT_STACK 0 /* Most bytes the stack can grow to */
+#define LIMIT_HEAP  1 /* Most bytes the heap can grow to */
+
+/* Bits of the error code the processor pushes for a page fault */
+#define FAULT_PRESENT 0x01 /* Page was present, so the access broke its protection */
+#define FAULT_WRITE   0x02 /* Access was a write */
+
+/* ELF program header values that the loader cares about */
+#define PT_LOAD 1
+#define PF_W 0x02
+
+/* ELF file header (32-bit) */
+typedef struct elf_header {
+    uint32_t magic;        /* ELF_HEADER */
+    uint8_t ident[12];     /* Rest of the identification bytes */
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint32_t entry;        /* Virtual address the program starts at */
+    uint32_t phoff;        /* Offset of the program headers in the file */
+    uint32_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;    /* Size of each program header */
+    uint16_t phnum;        /* Number of program headers */
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+} elf_header_t;
+
+/* ELF program header (32-bit); PT_LOAD headers describe the segments to map */
+typedef struct elf_program_header {
+    uint32_t type;
+    uint32_t offset;       /* Offset of the segment in the file */
+    uint32_t vaddr;        /* Virtual address of the segment */
+    uint32_t paddr;
+    uint32_t filesz;       /* Bytes of the segment that come from the file */
+    uint32_t memsz;        /* Bytes of the segment in memory; the rest is zeroed */
+    uint32_t flags;
+    uint32_t align;
+} elf_program_header_t;
+
+/* A range of a user address space whose pages are filled in when first touched */
+typedef struct vm_area {
+    uint32_t start;      /* First address of the area (page aligned) */
+    uint32_t end;        /* Address just past the area (page aligned) */
+    uint32_t flags;      /* VM_WRITE, VM_FILE, VM_HEAP, VM_STACK and VM_SHM */
+    uint32_t inode;      /* Inode of the file the area comes from (VM_FILE), or the segment ID (VM_SHM) */
+    uint32_t offset;     /* Offset in the file that start is mapped to */
+    uint32_t zero_start; /* Address where the file contents stop and zero fill starts */
+} vm_area_t;
+
+/* Most executables the kernel keeps a template of */
+#define MAX_EXEC_TEMPLATES 0x08
+
+/* An executable that has been parsed and had its file pages mapped */
+typedef struct exec_template {
+    uint32_t inode;                    /* Inode of the executable */
+    uint32_t entry;                    /* Entry point */
+    uint32_t brk;                      /* Start of the heap */
+    uint32_t* page_tables[USER_TABLES]; /* Pages of the file, read-only or copy-on-write */
+    vm_area_t vm_areas[MAX_VM_AREAS];   /* Areas every process starts with */
+    uint32_t num_vm_areas;              /* Number of areas (0 if the slot is free) */
+    uint32_t users;                     /* Number of processes started from it that are still running */
+} exec_template_t;
+
+struct pcb;
+
+/* Build a process's user address space from an ELF file (from its template); returns 0 and the entry point, or -1 */
+extern int32_t vm_exec(struct pcb* pcb, uint32_t inode, uint32_t* entry);
+
+/* Free a process's user pages and page tables */
+extern void vm_release(struct pcb* pcb);
+
+/* Give a forked child the parent's address space, sharing pages copy-on-write */
+extern int32_t vm_fork(struct pcb* child, struct pcb* parent);
+
+/* Move the end of a process's heap; returns the old end, or -1 */
+extern int32_t vm_brk(struct pcb* pcb, int32_t increment);
+
+/* Set a process's stack or heap limit; returns the old limit, or -1 */
+extern int32_t vm_set_limit(struct pcb* pcb, uint32_t resource, uint32_t limit);
+
+/* Map frames shared with other processes into a process; returns 0, or -1 */
+extern int32_t vm_map_shared(struct pcb* pcb, uint32_t address, uint32_t* frames, uint32_t num_pages, int32_t id);
+
+/* Unmap the shared area at an address; returns its segment ID, or -1 */
+extern int32_t vm_unmap_shared(struct pcb* pcb, uint32_t address);
+
+/* Map in the user address space of a process (the idle task has none) */
+extern void vm_switch(struct pcb* pcb);
+
+/* Fill in a page the current process faulted on; returns 0 if it can retry, -1 if not */
+extern int32_t vm_fault(uint32_t address, uint32_t error_code);
+
+/* Check that a buffer from a process is in its user window; returns 0, or -1 */
+extern int32_t vm_user_range(const void* buf, int32_t nbytes);
+
+#endif /* _VM_H */
@@ -0,0 +1,151 @@
+/* wait_queue.c - Functions for blocking processes until an event occurs
+ * vim:ts=4 noexpandtab
+ */
+
+#include "wait_queue.h"
+#include "scheduling.h"
+#include "lib.h"
+
+static void add_to_queue(wait_queue_t* queue, pcb_t* pcb);
+
+/*
+ * init_wait_queue
+ *   DESCRIPTION: Initializes a wait queue so that no processes are waiting on it
+ *   INPUTS: queue: The queue to initialize
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: None
+ */
+void init_wait_queue(wait_queue_t* queue)
+{
+    queue->head = NULL;
+    queue->tail = NULL;
+}
+
+
+/*
+ * add_to_queue
+ *   DESCRIPTION: Marks a process as blocked and adds it to the end of the queue
+ *   INPUTS: queue: The queue to add to
+ *           pcb: The process going to sleep
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: sched_lock must be held
+ */
+static void add_to_queue(wait_queue_t* queue, pcb_t* pcb)
+{
+    pcb->state = TASK_BLOCKED;
+    pcb->wait_next = NULL;
+
+    if (queue->tail)
+    {
+        queue->tail->wait_next = pcb;
+    }
+    else
+    {
+        queue->head = pcb;
+    }
+    queue->tail = pcb;
+}
+
+
+/*
+ * sleep_on
+ *   DESCRIPTION: Blocks the current process on the queue. The process is kept off
+ *                the run queue until wake_up is called on the queue.
+ *   INPUTS: queue: The queue to sleep on
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: Gives up the processor to the next runnable process (or the
+ *                 idle task if there is none)
+ */
+void sleep_on(wait_queue_t* queue)
+{
+    /* Local variables */
+    pcb_t* pcb;     /* The process that is going to sleep */
+    uint32_t flags; /* Save variable for flags */
+
+    /* Start critical section */
+    spin_lock_irqsave(&sched_lock, flags);
+
+    pcb = CURRENT_PCB_ADDRESS;
+    add_to_queue(queue, pcb);
+
+    /* The scheduler won't switch back to us until we have been woken up */
+    while (pcb->state == TASK_BLOCKED)
+    {
+        schedule_locked();
+    }
+
+    /* End critical section */
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+
+/*
+ * sleep_on_locked
+ *   DESCRIPTION: Blocks the current process on the queue, releasing a lock that
+ *                protects the condition being waited for. Since sched_lock is
+ *                taken before the lock is released, a wake_up done by whoever
+ *                takes the lock next can't be missed.
+ *   INPUTS: queue: The queue to sleep on
+ *           lock: The lock to release while asleep
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: The lock must be held with interrupts disabled. It is held
+ *                 again when this returns.
+ */
+void sleep_on_locked(wait_queue_t* queue, spinlock_t* lock)
+{
+    /* Local variables */
+    pcb_t* pcb; /* The process that is going to sleep */
+
+    spin_lock(&sched_lock);
+    spin_unlock(lock);
+
+    pcb = CURRENT_PCB_ADDRESS;
+    add_to_queue(queue, pcb);
+
+    /* The scheduler won't switch back to us until we have been woken up */
+    while (pcb->state == TASK_BLOCKED)
+    {
+        schedule_locked();
+    }
+
+    spin_unlock(&sched_lock);
+    spin_lock(lock);
+}
+
+
+/*
+ * wake_up
+ *   DESCRIPTION: Puts every process sleeping on the queue back on the run queue
+ *                (promoting it, since it gave up the processor) and empties the queue
+ *   INPUTS: queue: The queue to wake up
+ *   OUTPUTS: None
+ *   RETURN VALUE: None
+ *   SIDE EFFECTS: Safe to call from interrupt context
+ */
+void wake_up(wait_queue_t* queue)
+{
+    /* Local variables */
+    pcb_t* pcb;     /* Iteration variable for the processes in the queue */
+    pcb_t* next;    /* The process after the one being woken */
+    uint32_t flags; /* Save variable for flags */
+
+    /* Start critical section */
+    spin_lock_irqsave(&sched_lock, flags);
+
+    for (pcb = queue->head; pcb; pcb = next)
+    {
+        next = pcb->wait_next;
+        pcb->wait_next = NULL;
+        wake_process(pcb);
+    }
+
+    queue->head = NULL;
+    queue->tail = NULL;
+
+    /* End critical section */
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
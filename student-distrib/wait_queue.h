@@ -0,0 +1,29 @@
+/* wait_queue.h - Defines used for putting processes to sleep until an event occurs
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _WAIT_QUEUE_H
+#define _WAIT_QUEUE_H
+
+#include "types.h"
+#include "spinlock.h"
+
+/* Queue of processes that are blocked waiting on the same event */
+typedef struct wait_queue {
+    struct pcb* head; /* First process to have gone to sleep on the queue */
+    struct pcb* tail; /* Last process to have gone to sleep on the queue */
+} wait_queue_t;
+
+/* Initialize a wait queue to be empty */
+extern void init_wait_queue(wait_queue_t* queue);
+
+/* Block the current process on the queue until it is woken up */
+extern void sleep_on(wait_queue_t* queue);
+
+/* Block the current process on the queue, releasing the lock while asleep */
+extern void sleep_on_locked(wait_queue_t* queue, spinlock_t* lock);
+
+/* Wake up every process that is sleeping on the queue */
+extern void wake_up(wait_queue_t* queue);
+
+#endif /* _WAIT_QUEUE_H */
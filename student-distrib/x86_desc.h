@@ -16,6 +16,11 @@
 #define KERNEL_TSS  0x0030
 #define KERNEL_LDT  0x0038
 
+/* The TSS descriptors of the application processors follow the LDT's, one
+ * for each processor after the bootstrap processor (which uses KERNEL_TSS) */
+#define NUM_AP_TSS  0x07
+#define AP_TSS(id)  (KERNEL_LDT + 0x08 * (id))
+
 /* Size of the task state segment (TSS) */
 #define TSS_SIZE    104
 
@@ -124,6 +129,8 @@ extern uint32_t tss_size;
 extern seg_desc_t tss_desc_ptr;
 extern tss_t tss;
 
+extern seg_desc_t ap_tss_desc_ptr[NUM_AP_TSS];
+
 /* Sets runtime-settable parameters in the GDT entry for the LDT */
 #define SET_LDT_PARAMS(str, addr, lim)                          \
 do {                                                            \
@@ -6,22 +6,47 @@
 #define BUFSIZE 1024
 #define SBUFSIZE 33
 
+/* print a match with one system call: "fname:" (unless reading stdin), the line and its newline */
+static void
+print_match (const char* fname, const uint8_t* line)
+{
+    tmnt_iovec_t iov[4];
+    int32_t cnt = 0;
+
+    if (0 != fname) {
+	iov[cnt].base = (void*)fname;
+	iov[cnt++].len = tmnt_strlen ((uint8_t*)fname);
+	iov[cnt].base = ":";
+	iov[cnt++].len = 1;
+    }
+    iov[cnt].base = (void*)line;
+    iov[cnt++].len = tmnt_strlen (line);
+    iov[cnt].base = "\n";
+    iov[cnt++].len = 1;
+    tmnt_writev (1, iov, cnt);
+}
+
+/* search every line read from fd; fname prefixes each match (NULL for stdin) */
 int32_t
-do_one_file (const char* s, const char* fname) 
+do_one_fd (const char* s, int32_t fd, const char* fname) 
 {
-    int32_t fd, cnt, last, line_start, line_end, check, s_len;
-    uint8_t data[BUFSIZE+1];
+    int32_t cnt, last, line_start, line_end, check, s_len, size;
+    uint8_t* data;
+    uint8_t* bigger;
 
     s_len = tmnt_strlen ((uint8_t*)s);
-    if (-1 == (fd = tmnt_open ((uint8_t*)fname))) {
-        tmnt_fdputs (1, (uint8_t*)"file open failed\n");
+    /* the buffer doubles whenever a line doesn't fit in it */
+    size = BUFSIZE;
+    if (0 == (data = tmnt_malloc (size + 1))) {
+        tmnt_fdputs (1, (uint8_t*)"out of memory\n");
         return -1;
     }
     last = 0;
     while (1) {
-        cnt = tmnt_read (fd, data + last, BUFSIZE - last);
+        cnt = tmnt_read (fd, data + last, size - last);
 	if (-1 == cnt) {
             tmnt_fdputs (1, (uint8_t*)"file read failed\n");
+            tmnt_free (data);
             return -1;
 	}
 	last += cnt;
@@ -37,15 +62,22 @@ do_one_file (const char* s, const char* fname)
 		last -= line_start;
 		break;
 	    }
+	    if ('\n' != data[line_end] && 0 != cnt) {
+		/* the line so far starts the buffer; read more of it */
+		if (last < size)
+		    break;
+		if (0 != (bigger = tmnt_realloc (data, 2 * size + 1))) {
+		    data = bigger;
+		    size *= 2;
+		    break;
+		}
+	    }
 	    /* search the line */
 	    data[line_end] = '\0';
 	    for (check = line_start; check < line_end; check++) {
 		if (s[0] == data[check] && 
 		    0 == tmnt_strncmp ((uint8_t*)(data + check), (uint8_t*)s, s_len)) {
-		    tmnt_fdputs (1, (uint8_t*)fname);
-		    tmnt_fdputs (1, (uint8_t*)":");
-		    tmnt_fdputs (1, data + line_start);
-		    tmnt_fdputs (1, (uint8_t*)"\n");
+		    print_match (fname, data + line_start);
 		    break;
 		}
 	    }
@@ -58,11 +90,25 @@ do_one_file (const char* s, const char* fname)
 	if (0 == cnt)
 	    break;
     }
+    tmnt_free (data);
+    return 0;
+}
+
+int32_t
+do_one_file (const char* s, const char* fname) 
+{
+    int32_t fd, rval;
+
+    if (-1 == (fd = tmnt_open ((uint8_t*)fname))) {
+        tmnt_fdputs (1, (uint8_t*)"file open failed\n");
+        return -1;
+    }
+    rval = do_one_fd (s, fd, fname);
     if (-1 == tmnt_close (fd)) {
         tmnt_fdputs (1, (uint8_t*)"file close failed\n");
         return -1;
     }
-    return 0;
+    return rval;
 }
 
 int main ()
@@ -70,12 +116,26 @@ int main ()
     int32_t fd, cnt;
     uint8_t buf[SBUFSIZE];
     uint8_t search[BUFSIZE];
+    uint8_t* fname;
 
     if (0 != tmnt_getargs (search, BUFSIZE)) {
         tmnt_fdputs (1, (uint8_t*)"could not read argument\n");
         return 3;
     }
 
+    /* grep <string> reads stdin, grep <string> <file> searches the file,
+       and grep <string> . searches every file in the directory */
+    for (fname = search; '\0' != *fname && ' ' != *fname; fname++);
+    if ('\0' != *fname) {
+        *fname++ = '\0';
+	while (' ' == *fname)
+	    fname++;
+    }
+    if ('\0' == *fname)
+        return (0 != do_one_fd ((char*)search, 0, 0)) ? 3 : 0;
+    if (0 != tmnt_strcmp (fname, (uint8_t*)"."))
+        return (0 != do_one_file ((char*)search, (char*)fname)) ? 3 : 0;
+
     if (-1 == (fd = tmnt_open ((uint8_t*)"."))) {
         tmnt_fdputs (1, (uint8_t*)"directory open failed\n");
 	return 2;
@@ -4,11 +4,100 @@
 #include "tmntsyscall.h"
 
 #define BUFSIZE 1024
+#define MAX_STAGES 8
+
+static void report (int32_t fd, int32_t rval)
+{
+    if (-1 == rval)
+	tmnt_fdputs (fd, (uint8_t*)"no such command\n");
+    else if (256 == rval)
+	tmnt_fdputs (fd, (uint8_t*)"program terminated by exception\n");
+    else if (0 != rval)
+	tmnt_fdputs (fd, (uint8_t*)"program terminated abnormally\n");
+}
+
+/* Split a command line at each '|', trimming the spaces around each stage */
+static int32_t split_stages (uint8_t* buf, uint8_t** stages)
+{
+    int32_t n = 0;
+    uint8_t* end;
+
+    while (1) {
+	while (' ' == *buf)
+	    buf++;
+	if (MAX_STAGES == n)
+	    return -1;
+	stages[n++] = buf;
+	for (end = buf; '\0' != *end && '|' != *end; end++);
+	buf = end;
+	while (end > stages[n - 1] && ' ' == end[-1])
+	    end--;
+	if ('\0' == stages[n - 1][0] || '|' == stages[n - 1][0])
+	    return -1;
+	if ('\0' == *buf) {
+	    *end = '\0';
+	    return n;
+	}
+	*end = '\0';
+	buf++;
+    }
+}
+
+/* Run a pipeline, each stage's stdout feeding the next one's stdin. Every
+ * stage but the last runs in a forked child; the shell executes the last
+ * one itself, so the prompt comes back when it finishes. */
+static void run_pipeline (uint8_t** stages, int32_t n)
+{
+    int32_t fds[2], in_fd = -1, i;
+
+    for (i = 0; i < n - 1; i++) {
+	if (-1 == tmnt_pipe (fds)) {
+	    tmnt_fdputs (1, (uint8_t*)"pipe failed\n");
+	    if (-1 != in_fd)
+		tmnt_close (in_fd);
+	    return;
+	}
+	switch (tmnt_fork ()) {
+	case -1:
+	    tmnt_fdputs (1, (uint8_t*)"fork failed\n");
+	    tmnt_close (fds[0]);
+	    tmnt_close (fds[1]);
+	    if (-1 != in_fd)
+		tmnt_close (in_fd);
+	    return;
+	case 0:
+	    /* keep the terminal in the read end's slot for errors; execute
+	     * only passes on stdin and stdout */
+	    if (-1 != in_fd) {
+		tmnt_dup2 (in_fd, 0);
+		tmnt_close (in_fd);
+	    }
+	    tmnt_dup2 (1, fds[0]);
+	    tmnt_dup2 (fds[1], 1);
+	    tmnt_close (fds[1]);
+	    report (fds[0], tmnt_execute (stages[i]));
+	    tmnt_halt (0);
+	}
+	tmnt_close (fds[1]);
+	if (-1 != in_fd)
+	    tmnt_close (in_fd);
+	in_fd = fds[0];
+    }
+
+    /* the write end's fd is free again, so the shell's stdin waits there */
+    tmnt_dup2 (0, fds[1]);
+    tmnt_dup2 (in_fd, 0);
+    tmnt_close (in_fd);
+    report (1, tmnt_execute (stages[n - 1]));
+    tmnt_dup2 (fds[1], 0);
+    tmnt_close (fds[1]);
+}
 
 int main ()
 {
-    int32_t cnt, rval;
+    int32_t cnt, n;
     uint8_t buf[BUFSIZE];
+    uint8_t* stages[MAX_STAGES];
     tmnt_fdputs (1, (uint8_t*)"Starting TMNT Shell\n");
 
     while (1) {
@@ -24,13 +113,13 @@ int main ()
 	    return 0;
 	if ('\0' == buf[0])
 	    continue;
-	rval = tmnt_execute (buf);
-	if (-1 == rval)
-	    tmnt_fdputs (1, (uint8_t*)"no such command\n");
-	else if (256 == rval)
-	    tmnt_fdputs (1, (uint8_t*)"program terminated by exception\n");
-	else if (0 != rval)
-	    tmnt_fdputs (1, (uint8_t*)"program terminated abnormally\n");
+	if (-1 == (n = split_stages (buf, stages))) {
+	    tmnt_fdputs (1, (uint8_t*)"bad pipeline\n");
+	    continue;
+	}
+	if (1 == n)
+	    report (1, tmnt_execute (stages[0]));
+	else
+	    run_pipeline (stages, n);
     }
 }
-
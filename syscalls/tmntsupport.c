@@ -102,3 +102,212 @@ uint8_t* tmnt_strrev(uint8_t* s)
    return s;
 }
 
+
+/*
+ * The heap comes from tmnt_sbrk. Small blocks come in power of two size
+ * classes (16 bytes to 2KB, header included) carved out of 4KB chunks, and
+ * freed blocks go on a free list for their class, so malloc and free are a
+ * list pop and push. Bigger blocks are whole pages and are reused first fit.
+ */
+#define MALLOC_MIN_BLOCK   16
+#define MALLOC_NUM_CLASSES 8
+#define MALLOC_CHUNK       4096
+
+/* Header in front of every block; 8 bytes, so blocks keep the heap's alignment */
+typedef struct malloc_header {
+    uint32_t size;               /* Size class, or block size for big blocks */
+    struct malloc_header* next;  /* Next free block (only while free) */
+} malloc_header_t;
+
+static malloc_header_t* free_lists[MALLOC_NUM_CLASSES];
+static malloc_header_t* big_free_list;
+
+/* Usable bytes in a block */
+static uint32_t block_capacity(const malloc_header_t* block)
+{
+    if (block->size < MALLOC_NUM_CLASSES)
+        return (MALLOC_MIN_BLOCK << block->size) - sizeof(malloc_header_t);
+    return block->size - sizeof(malloc_header_t);
+}
+
+/* Fill an empty size class with the blocks of a new chunk */
+static int32_t malloc_refill(uint32_t class)
+{
+    uint8_t* chunk;
+    uint32_t block_size = MALLOC_MIN_BLOCK << class;
+    uint32_t offset;
+    malloc_header_t* block;
+
+    if (-1 == (int32_t)(chunk = (uint8_t*)tmnt_sbrk (MALLOC_CHUNK)))
+        return -1;
+    for (offset = 0; offset < MALLOC_CHUNK; offset += block_size) {
+        block = (malloc_header_t*)(chunk + offset);
+        block->next = free_lists[class];
+        free_lists[class] = block;
+    }
+    return 0;
+}
+
+void* tmnt_malloc(uint32_t size)
+{
+    uint32_t class;
+    malloc_header_t* block;
+    malloc_header_t** link;
+
+    if (0 == size || size > 0x7FFFFFFF - MALLOC_CHUNK)
+        return 0;
+
+    for (class = 0; class < MALLOC_NUM_CLASSES &&
+         (MALLOC_MIN_BLOCK << class) - sizeof(malloc_header_t) < size; class++);
+
+    if (class < MALLOC_NUM_CLASSES) {
+        if (0 == free_lists[class] && -1 == malloc_refill (class))
+            return 0;
+        block = free_lists[class];
+        free_lists[class] = block->next;
+        block->size = class;
+        return block + 1;
+    }
+
+    /* Big blocks are rounded to whole chunks */
+    size = (size + sizeof(malloc_header_t) + MALLOC_CHUNK - 1) & ~(MALLOC_CHUNK - 1);
+    for (link = &big_free_list; 0 != *link; link = &(*link)->next) {
+        if ((*link)->size >= size) {
+            block = *link;
+            *link = block->next;
+            return block + 1;
+        }
+    }
+    if (-1 == (int32_t)(block = (malloc_header_t*)tmnt_sbrk (size)))
+        return 0;
+    block->size = size;
+    return block + 1;
+}
+
+void* tmnt_realloc(void* ptr, uint32_t size)
+{
+    malloc_header_t* block;
+    uint8_t* new;
+    uint32_t i, capacity;
+
+    if (0 == ptr)
+        return tmnt_malloc (size);
+
+    block = (malloc_header_t*)ptr - 1;
+    capacity = block_capacity (block);
+    if (size <= capacity)
+        return ptr;
+
+    if (0 == (new = tmnt_malloc (size)))
+        return 0;
+    for (i = 0; i < capacity; i++)
+        new[i] = ((uint8_t*)ptr)[i];
+    tmnt_free (ptr);
+    return new;
+}
+
+void tmnt_free(void* ptr)
+{
+    malloc_header_t* block;
+
+    if (0 == ptr)
+        return;
+
+    block = (malloc_header_t*)ptr - 1;
+    if (block->size < MALLOC_NUM_CLASSES) {
+        block->next = free_lists[block->size];
+        free_lists[block->size] = block;
+    } else {
+        block->next = big_free_list;
+        big_free_list = block;
+    }
+}
+
+
+/*
+ * Time since boot, read from the time page without entering the kernel.
+ * The TSC gives it to the nanosecond (wrapping after 49 days); without
+ * one, it only moves in scheduler ticks.
+ */
+#define NSEC_PER_MSEC 1000000
+#define NSEC_PER_USEC 1000
+#define MSEC_PER_SEC  1000
+#define USEC_PER_SEC  1000000
+
+/* Divide hi:lo by d, keeping the low 32 bits of the quotient */
+static uint32_t div64(uint32_t hi, uint32_t lo, uint32_t d, uint32_t* rem)
+{
+    uint32_t quotient;
+
+    hi %= d;
+    asm volatile ("divl %4" : "=a"(quotient), "=d"(*rem) : "a"(lo), "d"(hi), "rm"(d));
+    return quotient;
+}
+
+void tmnt_clock_gettime(tmnt_timespec_t* ts)
+{
+    const tmnt_time_page_t* page = TMNT_TIME_PAGE;
+    uint32_t lo, hi, borrow, ms, cycles, per_sec, ticks;
+
+    if (0 == page->tsc_khz) {
+        ticks = page->ticks;
+        per_sec = USEC_PER_SEC / page->tick_us;
+        ts->tv_sec = ticks / per_sec;
+        ts->tv_nsec = (ticks % per_sec) * page->tick_us * NSEC_PER_USEC;
+        return;
+    }
+
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    borrow = (lo < page->boot_tsc_lo);
+    lo -= page->boot_tsc_lo;
+    hi -= page->boot_tsc_hi + borrow;
+
+    ms = div64 (hi, lo, page->tsc_khz, &cycles);
+    ts->tv_sec = ms / MSEC_PER_SEC;
+
+    /* cycles is under tsc_khz, so cycles * 10^6 / tsc_khz fits */
+    asm volatile ("mull %2" : "=a"(lo), "=d"(hi) : "rm"(NSEC_PER_MSEC), "a"(cycles));
+    ts->tv_nsec = (ms % MSEC_PER_SEC) * NSEC_PER_MSEC + div64 (hi, lo, page->tsc_khz, &cycles);
+}
+
+
+/*
+ * I/O rings: operations are queued with tmnt_io_queue, carried out all at
+ * once by tmnt_io_submit, and their results picked up with tmnt_io_reap.
+ * Buffers have to stay put until their operation completes.
+ */
+void tmnt_io_init(tmnt_io_ring_t* ring, tmnt_io_sqe_t* sqes, tmnt_io_cqe_t* cqes, uint32_t entries)
+{
+    ring->entries = entries;
+    ring->sq_head = ring->sq_tail = 0;
+    ring->cq_head = ring->cq_tail = 0;
+    ring->sqes = sqes;
+    ring->cqes = cqes;
+}
+
+/* Returns -1 if the submission queue is full */
+int32_t tmnt_io_queue(tmnt_io_ring_t* ring, int32_t op, int32_t fd, void* buf, int32_t nbytes, uint32_t user_data)
+{
+    tmnt_io_sqe_t* sqe;
+
+    if (ring->sq_tail - ring->sq_head == ring->entries)
+        return -1;
+    sqe = &ring->sqes[ring->sq_tail & (ring->entries - 1)];
+    sqe->op = op;
+    sqe->fd = fd;
+    sqe->buf = buf;
+    sqe->nbytes = nbytes;
+    sqe->user_data = user_data;
+    ring->sq_tail++;
+    return 0;
+}
+
+/* Returns -1 if there are no completions waiting */
+int32_t tmnt_io_reap(tmnt_io_ring_t* ring, tmnt_io_cqe_t* cqe)
+{
+    if (ring->cq_head == ring->cq_tail)
+        return -1;
+    *cqe = ring->cqes[ring->cq_head & (ring->entries - 1)];
+    ring->cq_head++;
+    return 0;
+}
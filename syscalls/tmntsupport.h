@@ -1,6 +1,8 @@
 #if !defined(TMNTSUPPORT_H)
 #define TMNTSUPPORT_H
 
+#include "tmntsyscall.h"
+
 extern uint32_t tmnt_strlen(const uint8_t* s);
 extern void tmnt_strcpy(uint8_t* dst, const uint8_t* src);
 extern void tmnt_fdputs(int32_t fd, const uint8_t* s);
@@ -8,6 +10,37 @@ extern int32_t tmnt_strcmp(const uint8_t* s1, const uint8_t* s2);
 extern int32_t tmnt_strncmp(const uint8_t* s1, const uint8_t* s2, uint32_t n);
 extern uint8_t *tmnt_itoa(uint32_t value, uint8_t* buf, int32_t radix);
 extern uint8_t *tmnt_strrev(uint8_t* s);
+extern void* tmnt_malloc(uint32_t size);
+extern void* tmnt_realloc(void* ptr, uint32_t size);
+extern void tmnt_free(void* ptr);
+
+/*
+ * Page the kernel maps read-only into every process, with the time in it
+ * (same layout as time_page_t in the kernel's clock.h). The quantum fields
+ * describe whichever process is running, so they're the caller's own.
+ */
+typedef struct tmnt_time_page {
+    uint32_t tsc_khz;               /* TSC cycles per millisecond, or 0 if there is no TSC */
+    uint32_t boot_tsc_lo;           /* TSC when the clock was started */
+    uint32_t boot_tsc_hi;
+    uint32_t tick_us;               /* Length of a scheduler tick in microseconds */
+    volatile uint32_t ticks;        /* Scheduler ticks so far (they only keep time without a TSC) */
+    volatile uint32_t quantum;      /* Ticks in the caller's quantum */
+    volatile uint32_t quantum_used; /* Ticks the caller has used of it */
+} tmnt_time_page_t;
+
+#define TMNT_TIME_PAGE ((const tmnt_time_page_t*)0x0C001000)
+
+typedef struct tmnt_timespec {
+    uint32_t tv_sec;
+    uint32_t tv_nsec;
+} tmnt_timespec_t;
+
+extern void tmnt_clock_gettime(tmnt_timespec_t* ts);
+
+extern void tmnt_io_init(tmnt_io_ring_t* ring, tmnt_io_sqe_t* sqes, tmnt_io_cqe_t* cqes, uint32_t entries);
+extern int32_t tmnt_io_queue(tmnt_io_ring_t* ring, int32_t op, int32_t fd, void* buf, int32_t nbytes, uint32_t user_data);
+extern int32_t tmnt_io_reap(tmnt_io_ring_t* ring, tmnt_io_cqe_t* cqe);
 
 #endif /* TMNTSUPPORT_H */
 
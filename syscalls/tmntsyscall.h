@@ -21,6 +21,15 @@ extern int32_t tmnt_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t tmnt_vidmap (uint8_t** screen_start);
 extern int32_t tmnt_set_handler (int32_t signum, void* handler);
 extern int32_t tmnt_sigreturn (void);
+extern int32_t tmnt_nice (int32_t increment);
+extern int32_t tmnt_fork (void);
+extern int32_t tmnt_sbrk (int32_t increment);
+extern int32_t tmnt_shm_create (uint32_t key, uint32_t size);
+extern int32_t tmnt_shm_map (int32_t id, void* address);
+extern int32_t tmnt_shm_unmap (void* address);
+extern int32_t tmnt_pipe (int32_t* fds);
+extern int32_t tmnt_dup2 (int32_t old_fd, int32_t new_fd);
+extern int32_t tmnt_setlimit (int32_t resource, uint32_t limit);
 
 enum signums {
 	DIV_ZERO = 0,
@@ -31,5 +40,67 @@ enum signums {
 	NUM_SIGNALS
 };
 
+enum limits {
+	LIMIT_STACK = 0,
+	LIMIT_HEAP
+};
+
+/*
+ * Operations queued on an I/O ring, which tmnt_io_submit carries out in
+ * one system call. The heads and tails only count up; they wrap around
+ * the queues with entries - 1 as a mask (entries is a power of two).
+ * The process moves sq_tail and cq_head, and the kernel the others.
+ */
+enum io_ops {
+	IO_OP_READ = 0,
+	IO_OP_WRITE,
+	IO_OP_OPEN,
+	IO_OP_CLOSE
+};
+
+typedef struct tmnt_io_sqe {
+	int32_t op;		/* IO_OP_* */
+	int32_t fd;
+	void* buf;		/* the filename for IO_OP_OPEN */
+	int32_t nbytes;
+	uint32_t user_data;	/* copied into the completion */
+} tmnt_io_sqe_t;
+
+typedef struct tmnt_io_cqe {
+	int32_t result;		/* what the system call would have returned */
+	uint32_t user_data;
+} tmnt_io_cqe_t;
+
+typedef struct tmnt_io_ring {
+	uint32_t entries;
+	uint32_t sq_head;
+	uint32_t sq_tail;
+	uint32_t cq_head;
+	uint32_t cq_tail;
+	tmnt_io_sqe_t* sqes;
+	tmnt_io_cqe_t* cqes;
+} tmnt_io_ring_t;
+
+extern int32_t tmnt_io_submit (tmnt_io_ring_t* ring);
+
+/* Buffers for tmnt_readv and tmnt_writev (up to 16 of them) */
+typedef struct tmnt_iovec {
+	void* base;
+	int32_t len;
+} tmnt_iovec_t;
+
+extern int32_t tmnt_readv (int32_t fd, const tmnt_iovec_t* iov, int32_t iovcnt);
+extern int32_t tmnt_writev (int32_t fd, const tmnt_iovec_t* iov, int32_t iovcnt);
+
+/* Where tmnt_lseek measures its offset from; only regular files can seek or pread */
+enum seek_whence {
+	TMNT_SEEK_SET,
+	TMNT_SEEK_CUR,
+	TMNT_SEEK_END
+};
+
+extern int32_t tmnt_lseek (int32_t fd, int32_t offset, int32_t whence);
+extern int32_t tmnt_pread (int32_t fd, void* buf, int32_t nbytes, int32_t offset);
+
 #endif /* TMNTSYSCALL_H */
 
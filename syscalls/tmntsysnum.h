@@ -11,5 +11,19 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_NICE  11
+#define SYS_FORK  12
+#define SYS_SBRK  13
+#define SYS_SHM_CREATE 14
+#define SYS_SHM_MAP    15
+#define SYS_SHM_UNMAP  16
+#define SYS_PIPE       17
+#define SYS_DUP2       18
+#define SYS_SETLIMIT   19
+#define SYS_IO_SUBMIT  20
+#define SYS_READV      21
+#define SYS_WRITEV     22
+#define SYS_LSEEK      23
+#define SYS_PREAD      24
 
 #endif /* TMNTSYSNUM_H */